@@ -56,9 +56,15 @@
  *              1 == no scalechange, experience: if shift == 0
  *              BoundingBox moved completely out of picture
  *              (not validated)
+ * @param work  Scratch memory of at least predictbbWorkSize(nPts) floats.
  */
 int predictbb(float *bb0, CvPoint2D32f* pt0, CvPoint2D32f* pt1, int nPts,
-    float*bb1, float*shift);
+    float*bb1, float*shift, float*work);
+/**
+ * Returns the number of floats predictbb needs as scratch memory.
+ * @param nPts  Number of feature points.
+ */
+int predictbbWorkSize(int nPts);
 
 /***********************************************************
  * EPILOGUE
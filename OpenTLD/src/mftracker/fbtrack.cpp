@@ -27,6 +27,7 @@
  * INCLUDES
  ***********************************************************/
 
+#include "fbtrack.h"
 #include "bb.h"
 #include "bb_predict.h"
 #include "median.h"
@@ -40,16 +41,21 @@
 /**
  * Calculate the bounding box of an Object in a following Image.
  * Imgs aren't changed.
+ * @param ctx        Working memory of the LK tracker. Each thread
+ *                   needs its own.
  * @param imgI       Image contain Object with known BoundingBox
  * @param imgJ       Following Image.
+ * @param pyrI       Pyramid buffer of imgI, or NULL. See trackLK.
+ * @param pyrJ       Pyramid buffer of imgJ, or NULL.
+ * @param pyrFlags   Which pyramids are already built. See trackLK.
  * @param bb         Bounding box of object to track in imgI.
  *                   Format x1,y1,x2,y2
  * @param scaleshift returns relative scale change of bb
  */
-int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew,
-    float* scaleshift)
+int fbtrack(LKContext *ctx, IplImage *imgI, IplImage *imgJ, IplImage *pyrI,
+    IplImage *pyrJ, int pyrFlags, float* bb, float* bbnew, float* scaleshift)
 {
-  char level = 5;
+  char level = FBTRACK_LEVEL;
   const int numM = 10;
   const int numN = 10;
   const int nPoints = numM * numN;
@@ -62,10 +68,12 @@ int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew,
   float pt[sizePointsArray];
   float ptTracked[sizePointsArray];
   int nlkPoints;
-  CvPoint2D32f* startPoints;
-  CvPoint2D32f* targetPoints;
-  float *fbLkCleaned;
-  float *nccLkCleaned;
+  //All points may survive the LK step, so the fixed sizes are enough
+  CvPoint2D32f startPoints[nPoints];
+  CvPoint2D32f targetPoints[nPoints];
+  float fbLkCleaned[nPoints];
+  float nccLkCleaned[nPoints];
+  float *work;
   int i,M;
   int nRealPoints;
   float medFb;
@@ -75,19 +83,16 @@ int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew,
   //getFilledBBPoints(bb, numM, numN, 5, &ptTracked);
   memcpy(ptTracked, pt, sizeof(float) * sizePointsArray);
 
-  initImgs();
-  trackLK(imgI, imgJ, pt, nPoints, ptTracked, nPoints, level, fb, ncc, status);
-  initImgs();
+  trackLK(ctx, imgI, imgJ, pyrI, pyrJ, pyrFlags, pt, nPoints, ptTracked,
+      nPoints, level, fb, ncc, status);
+  //Reserved by trackLK for nPoints points, which is also enough for the medians
+  work = ctx->work;
   //  char* status = *statusP;
   nlkPoints = 0;
   for (i = 0; i < nPoints; i++)
   {
     nlkPoints += status[i];
   }
-  startPoints = (CvPoint2D32f*) malloc(nlkPoints * sizeof(CvPoint2D32f));
-  targetPoints = (CvPoint2D32f*) malloc(nlkPoints * sizeof(CvPoint2D32f));
-  fbLkCleaned = (float*) malloc(nlkPoints * sizeof(float));
-  nccLkCleaned = (float*) malloc(nlkPoints * sizeof(float));
 
   M = 2;
   nRealPoints = 0;
@@ -111,8 +116,11 @@ int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew,
     }
   } 
   //assert nRealPoints==nlkPoints
-  medFb = getMedian(fbLkCleaned, nlkPoints);
-  medNcc = getMedian(nccLkCleaned, nlkPoints);
+  //getMedianUnmanaged reorders its input, so work on copies
+  memcpy(work, fbLkCleaned, sizeof(float) * nlkPoints);
+  medFb = getMedianUnmanaged(work, nlkPoints);
+  memcpy(work, nccLkCleaned, sizeof(float) * nlkPoints);
+  medNcc = getMedianUnmanaged(work, nlkPoints);
   /*  printf("medianfb: %f\nmedianncc: %f\n", medFb, medNcc);
    printf("Number of points after lk: %d\n", nlkPoints);*/
   nAfterFbUsage = 0;
@@ -132,16 +140,12 @@ int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew,
   //      nRealPoints);
   //  showIplImage(imgI);
 
-  predictbb(bb, startPoints, targetPoints, nAfterFbUsage, bbnew, scaleshift);
+  predictbb(bb, startPoints, targetPoints, nAfterFbUsage, bbnew, scaleshift, work);
   /*printf("bbnew: %f,%f,%f,%f\n", bbnew[0], bbnew[1], bbnew[2], bbnew[3]);
    printf("relative scale: %f \n", scaleshift[0]);*/
   //show picture with tracked bb
   //  drawRectFromBB(imgJ, bbnew);
   //  showIplImage(imgJ);  
-  free(startPoints);
-  free(targetPoints);
-  free(fbLkCleaned);
-  free(nccLkCleaned);
 
   if(medFb > 10) return 0;
   else return 1;
@@ -29,18 +29,34 @@
  * INCLUDES
  ***********************************************************/
 #include <opencv/cv.h>
+#include "lk.h"
+
+/***********************************************************
+ * CONSTANT AND MACRO DEFINITIONS
+ ***********************************************************/
+/**
+ * Pyramid level fbtrack tracks on. Pyramids handed to fbtrack
+ * must have been built for this level.
+ */
+const int FBTRACK_LEVEL = 5;
 
 /***********************************************************
  * FUNCTION
  ***********************************************************/
 /*
+ * @param ctx        Working memory of the LK tracker. Each thread
+ *                   needs its own.
  * @param imgI       Image contain Object with known BoundingBox
  * @param imgJ       Following Image.
+ * @param pyrI       Pyramid buffer of imgI, or NULL. See trackLK.
+ * @param pyrJ       Pyramid buffer of imgJ, or NULL.
+ * @param pyrFlags   Which pyramids are already built. See trackLK.
  * @param bb         Bounding box of object to track in imgI.
  *                   Format x1,y1,x2,y2
  * @param scaleshift returns relative scale change of bb
  */
-int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew, float* scaleshift);
+int fbtrack(LKContext *ctx, IplImage *imgI, IplImage *imgJ, IplImage *pyrI, IplImage *pyrJ,
+    int pyrFlags, float* bb, float* bbnew, float* scaleshift);
 
 #endif /* FBTRACK_H_ */
 /***********************************************************
@@ -28,6 +28,7 @@
  ***********************************************************/
 
 #include "lk.h"
+#include "bb_predict.h"
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
 #include <math.h>
@@ -44,8 +45,10 @@ const double N_A_N = -1.0;
  * Size of the search window of each pyramid level in cvCalcOpticalFlowPyrLK.
  */
 int win_size_lk = 4;
-CvPoint2D32f* points[3] = { 0, 0, 0 };
-static IplImage **PYR = 0;
+/**
+ * Size of the quadratic area compared by normCrossCorrelation.
+ */
+const int WIN_SIZE_NCC = 10;
 
 /***********************************************************
  * FUNCTION
@@ -70,6 +73,8 @@ void euclideanDistance(CvPoint2D32f *point1, CvPoint2D32f *point2,
 }
 /**
  * Calculates normalized cross correlation for every point.
+ * @param ctx       Context holding the patch buffers.
+ *                  Their size is the compared area.
  * @param imgI      Image 1.
  * @param imgJ      Image 2.
  * @param points0   Array of points of imgI
@@ -80,66 +85,138 @@ void euclideanDistance(CvPoint2D32f *point1, CvPoint2D32f *point2,
  *                  else match[i] = 0.0
  * @param match     Output: Array will contain ncc values.
  *                  0.0 if not calculated.
- * @param winsize   Size of quadratic area around the point
- *                  which is compared.
  * @param method    Specifies the way how image regions are compared.
  *                  see cvMatchTemplate
  */
-void normCrossCorrelation(IplImage *imgI, IplImage *imgJ,
+void normCrossCorrelation(LKContext *ctx, IplImage *imgI, IplImage *imgJ,
     CvPoint2D32f *points0, CvPoint2D32f *points1, int nPts, char *status,
-    float *match, int winsize, int method)
+    float *match, int method)
 {
-  IplImage *rec0 = cvCreateImage(cvSize(winsize, winsize), 8, 1);
-  IplImage *rec1 = cvCreateImage(cvSize(winsize, winsize), 8, 1);
-  IplImage *res = cvCreateImage(cvSize(1, 1), IPL_DEPTH_32F, 1);
-
   int i;
   for (i = 0; i < nPts; i++)
   {
     if (status[i] == 1)
     {
-      cvGetRectSubPix(imgI, rec0, points0[i]);
-      cvGetRectSubPix(imgJ, rec1, points1[i]);
-      cvMatchTemplate(rec0, rec1, res, method);
-      match[i] = ((float *) (res->imageData))[0];
+      cvGetRectSubPix(imgI, ctx->rec0, points0[i]);
+      cvGetRectSubPix(imgJ, ctx->rec1, points1[i]);
+      cvMatchTemplate(ctx->rec0, ctx->rec1, ctx->res, method);
+      match[i] = ((float *) (ctx->res->imageData))[0];
     }
     else
     {
       match[i] = 0.0;
     }
   }
-  cvReleaseImage(&rec0);
-  cvReleaseImage(&rec1);
-  cvReleaseImage(&res);
 }
+
+void initLKContext(LKContext *ctx)
+{
+  int i;
+  for (i = 0; i < MAX_IMG; i++)
+  {
+    ctx->pyr[i] = 0;
+  }
+  for (i = 0; i < 3; i++)
+  {
+    ctx->points[i] = 0;
+  }
+  ctx->statusBacktrack = 0;
+  ctx->work = 0;
+  ctx->capacity = 0;
+  ctx->rec0 = 0;
+  ctx->rec1 = 0;
+  ctx->res = 0;
+}
+
+void releaseLKContext(LKContext *ctx)
+{
+  int i;
+  for (i = 0; i < MAX_IMG; i++)
+  {
+    cvReleaseImage(&(ctx->pyr[i]));
+  }
+  for (i = 0; i < 3; i++)
+  {
+    free(ctx->points[i]);
+  }
+  free(ctx->statusBacktrack);
+  free(ctx->work);
+  cvReleaseImage(&(ctx->rec0));
+  cvReleaseImage(&(ctx->rec1));
+  cvReleaseImage(&(ctx->res));
+  initLKContext(ctx);
+}
+
+void buildPyramidLK(IplImage *img, IplImage *pyr, int level)
+{
+  //OpenCV has no call for the pyramid alone, so a single point is tracked
+  //from img to itself. The second pyramid is the first one, once built.
+  CvPoint2D32f point = cvPoint2D32f(0, 0);
+  CvPoint2D32f tracked = point;
+  char status;
+  cvCalcOpticalFlowPyrLK(img, img, pyr, pyr, &point, &tracked, 1,
+      cvSize(win_size_lk, win_size_lk), level, &status, 0, cvTermCriteria(
+          CV_TERMCRIT_ITER, 1, 0), CV_LKFLOW_PYR_B_READY);
+}
+
 /**
- * Needed before start of trackLK and at the end of the program for cleanup.
- * Handles PYR(Pyramid cache) variable.
+ * Makes sure the context's buffers fit the images and number of points.
+ * Buffers which are already big enough are kept.
+ * The pyramid buffers are only allocated if usePyr is set.
  */
-void initImgs()
+static void reserveLKContext(LKContext *ctx, CvSize imgSize, int nPts,
+    int usePyr)
 {
-  if (PYR != 0)
+  int i;
+  CvSize pyr_sz = cvSize(imgSize.width + 8, imgSize.height / 3);
+  for (i = 0; usePyr && i < MAX_IMG; i++)
+  {
+    if (ctx->pyr[i] != 0 && (ctx->pyr[i]->width != pyr_sz.width
+        || ctx->pyr[i]->height != pyr_sz.height))
+    {
+      cvReleaseImage(&(ctx->pyr[i]));
+    }
+    if (ctx->pyr[i] == 0)
+    {
+      ctx->pyr[i] = cvCreateImage(pyr_sz, IPL_DEPTH_32F, 1);
+    }
+  }
+
+  if (nPts > ctx->capacity)
   {
-    int i;
-    for (i = 0; i < MAX_IMG; i++)
+    for (i = 0; i < 3; i++)
     {
-      cvReleaseImage(&(PYR[i]));
-      PYR[i] = 0;
+      free(ctx->points[i]);
+      ctx->points[i] = (CvPoint2D32f*) malloc(nPts * sizeof(CvPoint2D32f));
     }
-    free(PYR);
-    PYR = 0;
-    //printf("LK: deallocated\n");
+    free(ctx->statusBacktrack);
+    ctx->statusBacktrack = (char*) malloc(nPts);
+    free(ctx->work);
+    ctx->work = (float*) malloc(predictbbWorkSize(nPts) * sizeof(float));
+    ctx->capacity = nPts;
+  }
+
+  if (ctx->rec0 == 0)
+  {
+    ctx->rec0 = cvCreateImage(cvSize(WIN_SIZE_NCC, WIN_SIZE_NCC), 8, 1);
+    ctx->rec1 = cvCreateImage(cvSize(WIN_SIZE_NCC, WIN_SIZE_NCC), 8, 1);
+    ctx->res = cvCreateImage(cvSize(1, 1), IPL_DEPTH_32F, 1);
   }
-  PYR = (IplImage**) calloc(MAX_IMG, sizeof(IplImage*));
-  //printf("LK: initialized\n");
 }
 
 /**
  * Tracks Points from 1.Image to 2.Image.
- * Need initImgs before start and at the end of the program for cleanup.
  *
+ * @param ctx       Working memory, see LKContext. Must have been initialized
+ *                  with initLKContext.
  * @param imgI      previous Image source. (isn't changed)
  * @param imgJ      actual Image target. (isn't changed)
+ * @param pyrI      Pyramid buffer of imgI, or 0 to use the context's.
+ *                  See cvCalcOpticalFlowPyrLK for its size.
+ * @param pyrJ      Pyramid buffer of imgJ, or 0 to use the context's.
+ * @param pyrFlags  CV_LKFLOW_PYR_A_READY if pyrI already holds the pyramid
+ *                  of imgI, CV_LKFLOW_PYR_B_READY if pyrJ holds the one of
+ *                  imgJ. Both hold their pyramids afterwards.
  * @param ptsI      points to track from first Image.
  *                  Format [0] = x1, [1] = y1, [2] = x2 ...
  * @param nPtsI     number of Points to track from first Image
@@ -158,16 +235,18 @@ void initImgs()
  * Based Matlab function:
  * lk(2,imgI,imgJ,ptsI,ptsJ,Level) (Level is optional)
  */
-int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
-    float ptsJ[], int nPtsJ, int level, float * fb, float*ncc, char*status)
+int trackLK(LKContext *ctx, IplImage *imgI, IplImage *imgJ, IplImage *pyrI,
+    IplImage *pyrJ, int pyrFlags, float ptsI[], int nPtsI, float ptsJ[],
+    int nPtsJ, int level, float * fb, float*ncc, char*status)
 {
   //TODO: watch NaN cases
   //double nan = std::numeric_limits<double>::quiet_NaN();
   //double inf = std::numeric_limits<double>::infinity();
 
   // tracking
-  int I, J, winsize_ncc;
-  CvSize pyr_sz;
+  int I, J;
+  CvPoint2D32f **points;
+  char *statusBacktrack;
   int i;
   //if unused std 5
   if (level == -1)
@@ -176,12 +255,6 @@ int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
   }
   I = 0;
   J = 1;
-  winsize_ncc = 10;
-
-  //NOTE: initImgs() must be used correctly or memleak will follow.
-  pyr_sz = cvSize(imgI->width + 8, imgI->height / 3);
-  PYR[I] = cvCreateImage(pyr_sz, IPL_DEPTH_32F, 1);
-  PYR[J] = cvCreateImage(pyr_sz, IPL_DEPTH_32F, 1);
 
   // Points
   if (nPtsJ != nPtsI)
@@ -190,11 +263,19 @@ int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
     return 0;
   }
 
-  points[0] = (CvPoint2D32f*) malloc(nPtsI * sizeof(CvPoint2D32f)); // template
-  points[1] = (CvPoint2D32f*) malloc(nPtsI * sizeof(CvPoint2D32f)); // target
-  points[2] = (CvPoint2D32f*) malloc(nPtsI * sizeof(CvPoint2D32f)); // forward-backward
-  //TODO:Free
-  char* statusBacktrack = (char*) malloc(nPtsI);
+  reserveLKContext(ctx, cvGetSize(imgI), nPtsI, pyrI == 0 || pyrJ == 0);
+  points = ctx->points;
+  statusBacktrack = ctx->statusBacktrack;
+  if (pyrI == 0)
+  {
+    pyrI = ctx->pyr[I];
+    pyrFlags &= ~CV_LKFLOW_PYR_A_READY;
+  }
+  if (pyrJ == 0)
+  {
+    pyrJ = ctx->pyr[J];
+    pyrFlags &= ~CV_LKFLOW_PYR_B_READY;
+  }
 
   for (i = 0; i < nPtsI; i++)
   {
@@ -207,13 +288,13 @@ int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
   }
 
   //lucas kanade track
-  cvCalcOpticalFlowPyrLK(imgI, imgJ, PYR[I], PYR[J], points[0], points[1],
+  cvCalcOpticalFlowPyrLK(imgI, imgJ, pyrI, pyrJ, points[0], points[1],
       nPtsI, cvSize(win_size_lk, win_size_lk), level, status, 0, cvTermCriteria(
           CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03),
-      CV_LKFLOW_INITIAL_GUESSES);
+      CV_LKFLOW_INITIAL_GUESSES | pyrFlags);
 
   //backtrack
-  cvCalcOpticalFlowPyrLK(imgJ, imgI, PYR[J], PYR[I], points[1], points[2],
+  cvCalcOpticalFlowPyrLK(imgJ, imgI, pyrJ, pyrI, points[1], points[2],
       nPtsI, cvSize(win_size_lk, win_size_lk), level, statusBacktrack, 0, cvTermCriteria(
           CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03),
       CV_LKFLOW_INITIAL_GUESSES | CV_LKFLOW_PYR_A_READY | CV_LKFLOW_PYR_B_READY);
@@ -227,8 +308,8 @@ int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
     	  status[i] = 0;
       }
     }
-  normCrossCorrelation(imgI, imgJ, points[0], points[1], nPtsI, status, ncc,
-      winsize_ncc, CV_TM_CCOEFF_NORMED);
+  normCrossCorrelation(ctx, imgI, imgJ, points[0], points[1], nPtsI, status,
+      ncc, CV_TM_CCOEFF_NORMED);
   euclideanDistance(points[0], points[2], fb, nPtsI);
 
   for (i = 0; i < nPtsI; i++)
@@ -247,12 +328,6 @@ int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
       ncc[i] = N_A_N;
     }
   }
-  for (i = 0; i < 3; i++)
-  {
-    free(points[i]);
-    points[i] = 0;
-  }
-  free(statusBacktrack);
   return 1;
 }
 
@@ -43,17 +43,43 @@
 /***********************************************************
  * DATA DEFINITIONS
  ***********************************************************/
+/**
+ * Working memory of trackLK.
+ * Buffers are allocated on first use and kept for later calls, so
+ * tracking the same number of points in same-sized images doesn't
+ * allocate anything. Each thread calling trackLK needs its own context.
+ */
+typedef struct LKContext
+{
+  IplImage *pyr[2];           /* pyramid buffers of both images */
+  CvPoint2D32f *points[3];    /* template, target, forward-backward */
+  char *statusBacktrack;      /* status of the backward track */
+  float *work;                /* scratch memory of predictbb, see predictbbWorkSize */
+  int capacity;               /* number of points the point buffers can hold */
+  IplImage *rec0;             /* patch of the first image, for NCC */
+  IplImage *rec1;             /* patch of the second image, for NCC */
+  IplImage *res;              /* NCC result */
+} LKContext;
 
 /***********************************************************
  * FUNCTIONS
  ***********************************************************/
 /**
- * Need before start of trackLK and at the end of the program for cleanup.
+ * Initializes an empty context. Call before its first use.
+ */
+void initLKContext(LKContext *ctx);
+/**
+ * Frees all buffers of a context. It can be used again afterwards.
+ */
+void releaseLKContext(LKContext *ctx);
+/**
+ * Builds the pyramid of img into pyr, as cvCalcOpticalFlowPyrLK would for
+ * level, so that it can be handed to trackLK as ready.
  */
-void initImgs();
-int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
-    float ptsJ[], int nPtsJ, int level, float * fbOut, float*nccOut,
-    char*statusOut);
+void buildPyramidLK(IplImage *img, IplImage *pyr, int level);
+int trackLK(LKContext *ctx, IplImage *imgI, IplImage *imgJ, IplImage *pyrI,
+    IplImage *pyrJ, int pyrFlags, float ptsI[], int nPtsI, float ptsJ[],
+    int nPtsJ, int level, float * fbOut, float*nccOut, char*statusOut);
 
 #endif /* LK_H_ */
 
@@ -0,0 +1,96 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * AllocationCounter.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace tld {
+
+static unsigned long allocationCount = 0;
+
+bool tldCountsAllocations() {
+#ifdef TLD_COUNT_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Returns the number of heap allocations done so far by all threads.
+ * Always 0 if TLD_COUNT_ALLOCATIONS is not defined.
+ */
+unsigned long tldNumAllocations() {
+	#pragma omp flush(allocationCount)
+	return allocationCount;
+}
+
+void tldCountAllocation() {
+#ifdef TLD_COUNT_ALLOCATIONS
+	#pragma omp atomic
+	allocationCount++;
+#endif
+}
+
+} /* namespace tld */
+
+#ifdef TLD_COUNT_ALLOCATIONS
+
+#if __cplusplus >= 201103L
+#define TLD_THROWS_BAD_ALLOC
+#define TLD_THROWS_NOTHING noexcept
+#else
+#define TLD_THROWS_BAD_ALLOC throw(std::bad_alloc)
+#define TLD_THROWS_NOTHING throw()
+#endif
+
+static void* countedAlloc(size_t size) {
+	tld::tldCountAllocation();
+
+	void* p = malloc(size != 0 ? size : 1);
+	if(p == NULL) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new(size_t size) TLD_THROWS_BAD_ALLOC {
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size) TLD_THROWS_BAD_ALLOC {
+	return countedAlloc(size);
+}
+
+void operator delete(void* p) TLD_THROWS_NOTHING {
+	free(p);
+}
+
+void operator delete[](void* p) TLD_THROWS_NOTHING {
+	free(p);
+}
+
+#endif /* TLD_COUNT_ALLOCATIONS */
@@ -0,0 +1,45 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * AllocationCounter.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef ALLOCATIONCOUNTER_H_
+#define ALLOCATIONCOUNTER_H_
+
+namespace tld {
+
+/*
+ * Counts heap allocations of the whole process, so tests can check that
+ * processing a frame does not touch the heap once it has warmed up.
+ *
+ * Counting is only compiled in if TLD_COUNT_ALLOCATIONS is defined, which debug
+ * builds do. It then replaces the global operator new, so every allocation of
+ * std containers and of new is counted. malloc() is not hooked; code using it
+ * directly, like WorkingSet, calls tldCountAllocation() itself. Buffers OpenCV
+ * allocates internally (cv::Mat, IplImage) are not counted.
+ */
+bool tldCountsAllocations();
+unsigned long tldNumAllocations();
+void tldCountAllocation();
+
+} /* namespace tld */
+#endif /* ALLOCATIONCOUNTER_H_ */
@@ -0,0 +1,115 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * Checkpoint.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "Checkpoint.h"
+#include "TLDUtil.h"
+
+#include <cstring>
+
+namespace tld {
+
+static const char TLD_CHECKPOINT_MAGIC[4] = {'T','L','D','C'};
+
+//Larger sizes can only come from a damaged header
+static const unsigned int TLD_CHECKPOINT_MAX_RECORD_SIZE = 1 << 28;
+
+struct CheckpointRecordHeader {
+	char magic[4];
+	unsigned int version;
+	unsigned int size; //Bytes of payload
+	unsigned int checksum; //Adler-32 of the payload
+};
+
+CheckpointRecord::CheckpointRecord() {
+	position = 0;
+}
+
+//Starts a new record; the buffer keeps its capacity from earlier records
+void CheckpointRecord::begin() {
+	buffer.resize(sizeof(CheckpointRecordHeader));
+	position = sizeof(CheckpointRecordHeader);
+}
+
+void CheckpointRecord::put(const void* data, size_t size) {
+	size_t end = buffer.size();
+	buffer.resize(end + size);
+	memcpy(&buffer[end], data, size);
+}
+
+/*
+ * Writes the record to the end of the file at path, or replaces the file if truncate is set.
+ * The file is flushed but not synced, which would stall the caller.
+ */
+bool CheckpointRecord::appendTo(const char* path, bool truncate) {
+	CheckpointRecordHeader header;
+	memcpy(header.magic, TLD_CHECKPOINT_MAGIC, sizeof(TLD_CHECKPOINT_MAGIC));
+	header.version = TLD_CHECKPOINT_VERSION;
+	header.size = buffer.size() - sizeof(header);
+	header.checksum = tldAdler32(1, &buffer[0] + sizeof(header), header.size);
+	memcpy(&buffer[0], &header, sizeof(header));
+
+	FILE* file = fopen(path, truncate ? "wb" : "ab");
+	if(file == NULL) {
+		printf("Error: Unable to write checkpoint %s\n", path);
+		return false;
+	}
+
+	bool ok = fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size();
+	ok = (fclose(file) == 0) && ok;
+
+	if(!ok) {
+		printf("Error: Unable to write checkpoint %s\n", path);
+	}
+	return ok;
+}
+
+//Reads the next record of file. Returns false at the end of the file and at the first damaged record.
+bool CheckpointRecord::readFrom(FILE* file) {
+	CheckpointRecordHeader header;
+	if(fread(&header, sizeof(header), 1, file) != 1
+			|| memcmp(header.magic, TLD_CHECKPOINT_MAGIC, sizeof(TLD_CHECKPOINT_MAGIC)) != 0
+			|| header.version != TLD_CHECKPOINT_VERSION
+			|| header.size > TLD_CHECKPOINT_MAX_RECORD_SIZE) {
+		return false;
+	}
+
+	buffer.resize(sizeof(header) + header.size);
+	position = sizeof(header);
+	if(header.size > 0 && fread(&buffer[position], header.size, 1, file) != 1) {
+		return false;
+	}
+
+	return tldAdler32(1, &buffer[0] + position, header.size) == header.checksum;
+}
+
+bool CheckpointRecord::get(void* data, size_t size) {
+	if(size > buffer.size() - position) {
+		return false;
+	}
+	memcpy(data, &buffer[position], size);
+	position += size;
+	return true;
+}
+
+} /* namespace tld */
@@ -0,0 +1,89 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * Checkpoint.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <cstdio>
+#include <vector>
+
+namespace tld {
+
+static const unsigned int TLD_CHECKPOINT_VERSION = 1;
+
+/*
+ * Fixed part of a checkpoint record. It is followed by
+ *  features: 4*numFeatures*numTrees floats, in full records only
+ *  numChangedTruePositives, then numChangedFalsePositives times: the row and its TLD_PATCH_SIZE^2 values
+ *  numChangedLeaves times: the index into EnsembleClassifier::leaves and the FernLeaf
+ * A full record holds the whole model; any other record only what changed since the record
+ * before it. Row counts are those after the record has been applied.
+ */
+struct CheckpointState {
+	int full;
+	int imgWidth;
+	int imgHeight;
+	int imgWidthStep;
+	int objWidth;
+	int objHeight;
+	float minVar;
+	int numTrees;
+	int numFeatures;
+	int valid;
+	int wasValid;
+	int hasBB;
+	int bbX;
+	int bbY;
+	int bbWidth;
+	int bbHeight;
+	float currConf;
+	int numTruePositives;
+	int numFalsePositives;
+	int numChangedTruePositives;
+	int numChangedFalsePositives;
+	int numChangedLeaves;
+};
+
+/*
+ * One record of a checkpoint file. A file starts with a full record, and every later record
+ * is appended with a single write. Each record carries its size and an Adler-32 checksum, so
+ * a record cut short by a crash ends the file instead of corrupting the model.
+ */
+class CheckpointRecord {
+	std::vector<char> buffer; //Record header followed by the payload
+	size_t position; //Where get() continues
+
+public:
+	CheckpointRecord();
+
+	void begin();
+	void put(const void* data, size_t size);
+	bool appendTo(const char* path, bool truncate);
+
+	bool readFrom(FILE* file);
+	bool get(void* data, size_t size);
+};
+
+} /* namespace tld */
+#endif /* CHECKPOINT_H_ */
@@ -33,184 +33,109 @@ namespace tld {
 
 Clustering::Clustering() {
 	cutoff = .5;
-	windows = NULL;
+	windowGrid = NULL;
 	numWindows = 0;
+	workingSet = NULL;
 }
 
 Clustering::~Clustering() {
 }
 
 void Clustering::release() {
-	windows = NULL;
+	windowGrid = NULL;
 	numWindows = 0;
 }
 
-void Clustering::calcMeanRect(vector<int> * indices) {
-
-	float x,y,w,h;
-	x=y=w=h=0;
-
-	int numIndices = indices->size();
-	for(int i = 0; i < numIndices; i++) {
-		int * bb = &windows[TLD_WINDOW_SIZE*indices->at(i)];
-		x += bb[0];
-		y += bb[1];
-		w += bb[2];
-		h += bb[3];
+static int findRoot(int * parents, int i) {
+	while(parents[i] != i) {
+		parents[i] = parents[parents[i]]; //Path halving
+		i = parents[i];
 	}
-
-	x /= numIndices;
-	y /= numIndices;
-	w /= numIndices;
-	h /= numIndices;
-
-	Rect* rect = new Rect();
-	detectionResult->detectorBB = rect;
-	rect->x = floor(x+0.5);
-	rect->y = floor(y+0.5);
-	rect->width = floor(w+0.5);
-	rect->height = floor(h+0.5);
-
+	return i;
 }
 
-//distances must be of size n*(n+1)/2
-void Clustering::calcDistances(float * distances) {
-	float * distances_tmp = distances;
-
-	vector<int> confidentIndices = *detectionResult->confidentIndices;
+//Single linkage: windows closer than cutoff are in the same cluster, and so are all windows
+//connected by a chain of such pairs. Clusters are numbered in the order of their first window.
+void Clustering::cluster(int * clusterIndices) {
+	vector<int>& confidentIndices = *detectionResult->confidentIndices;
+	int numConfidentIndices = confidentIndices.size();
 
-	size_t indices_size = confidentIndices.size();
-
-	for(size_t i = 0; i < confidentIndices.size(); i++) {
-		int firstIndex = confidentIndices.at(0);
-		confidentIndices.erase(confidentIndices.begin());
-		tldOverlapOne(windows, numWindows, firstIndex, &confidentIndices, distances_tmp);
-		distances_tmp += indices_size-i-1;
-	}
-
-	for(size_t i = 0; i < indices_size*(indices_size-1)/2; i++) {
-		distances[i] = 1-distances[i];
+	//Union-find forest. Every root is the smallest index in its tree.
+	int * parents = workingSet->alloc<int>(numConfidentIndices);
+	for(int i = 0; i < numConfidentIndices; i++) {
+		parents[i] = i;
 	}
 
-}
+	int buffer1[TLD_WINDOW_SIZE];
+	int buffer2[TLD_WINDOW_SIZE];
+	for(int i = 0; i < numConfidentIndices; i++) {
+		int * bb1 = windowGrid->window(confidentIndices[i], buffer1);
+		for(int j = i+1; j < numConfidentIndices; j++) {
+			int root1 = findRoot(parents, i);
+			int root2 = findRoot(parents, j);
+			if(root1 == root2) {
+				continue; //Connected already, no need to compute the distance
+			}
 
-void Clustering::clusterConfidentIndices() {
-	int numConfidentIndices = detectionResult->confidentIndices->size();
-	float * distances = new float[numConfidentIndices*(numConfidentIndices-1)/2];
-	calcDistances(distances);
-	int * clusterIndices = new int[numConfidentIndices];
-	cluster(distances, clusterIndices);
-	if(detectionResult->numClusters == 1) {
-		calcMeanRect(detectionResult->confidentIndices);
-		//TODO: Take the maximum confidence as the result confidence.
+			float distance = 1-tldBBOverlap(bb1, windowGrid->window(confidentIndices[j], buffer2));
+			if(distance < cutoff) {
+				parents[max(root1, root2)] = min(root1, root2);
+			}
+		}
 	}
 
+	int numClusters = 0;
+	for(int i = 0; i < numConfidentIndices; i++) {
+		int root = findRoot(parents, i);
+		clusterIndices[i] = (root == i) ? numClusters++ : clusterIndices[root];
+	}
 
+	detectionResult->numClusters = numClusters;
 }
 
-void Clustering::cluster(float * distances, int * clusterIndices) {
-	int numConfidentIndices = detectionResult->confidentIndices->size();
-
-	if(numConfidentIndices == 1) {
-		clusterIndices[0] = 0;
-		detectionResult->numClusters = 1;
-		return;
-	}
-
-	int numDistances = numConfidentIndices*(numConfidentIndices-1)/2;
+void Clustering::calcMeanRects(int * clusterIndices) {
+	vector<int>& confidentIndices = *detectionResult->confidentIndices;
+	int numConfidentIndices = confidentIndices.size();
+	int numClusters = detectionResult->numClusters;
 
-	//Now: Cluster distances
-	int * distUsed = new int[numDistances];
-	for(int i = 0; i < numDistances; i++) {
-		distUsed[i] = 0;
+	//x, y, w, h and the number of windows of each cluster
+	float * sums = workingSet->alloc<float>(5*numClusters);
+	for(int i = 0; i < 5*numClusters; i++) {
+		sums[i] = 0;
 	}
 
+	int buffer[TLD_WINDOW_SIZE];
 	for(int i = 0; i < numConfidentIndices; i++) {
-		clusterIndices[i] = -1;
+		int * bb = windowGrid->window(confidentIndices[i], buffer);
+		float * sum = &sums[5*clusterIndices[i]];
+		sum[0] += bb[0];
+		sum[1] += bb[1];
+		sum[2] += bb[2];
+		sum[3] += bb[3];
+		sum[4]++;
 	}
 
-	int newClusterIndex = 0;
-
-	int numClusters = 0;
-	while(true) {
-
-		//Search for the shortest distance
-		float shortestDist = -1;
-		int shortestDistIndex = -1;
-		int i1;
-		int i2;
-		int distIndex = 0;
-		for(int i = 0; i < numConfidentIndices; i++) { //Row index
-			for(int j = i+1; j < numConfidentIndices; j++) { //Start from i+1
-
-				if(!distUsed[distIndex] && (shortestDistIndex == -1 || distances[distIndex] < shortestDist)) {
-					shortestDist = distances[distIndex];
-					shortestDistIndex = distIndex;
-					i1=i;
-					i2=j;
-				}
-
-				distIndex++;
-			}
-		}
-
-		if(shortestDistIndex == -1) {
-			break; // We are done
-		}
-
-		distUsed[shortestDistIndex] = 1;
-
-		//Now: Compare the cluster indices
-		//If both have no cluster and distance is low, put them both to a new cluster
-		if(clusterIndices[i1] == -1 && clusterIndices[i2] == -1) {
-			//If distance is short, put them to the same cluster
-			if(shortestDist < cutoff) {
-				clusterIndices[i1] = clusterIndices[i2] = newClusterIndex;
-				newClusterIndex++;
-				numClusters++;
-			} else { //If distance is long, put them to different clusters
-				clusterIndices[i1] = newClusterIndex;
-				newClusterIndex++;
-				numClusters++;
-				clusterIndices[i2] = newClusterIndex;
-				newClusterIndex++;
-				numClusters++;
-			}
-			//Second point is  in cluster already
-		} else if (clusterIndices[i1] == -1 && clusterIndices[i2] != -1) {
-			if(shortestDist < cutoff) {
-				clusterIndices[i1] = clusterIndices[i2];
-			} else { //If distance is long, put them to different clusters
-				clusterIndices[i1] = newClusterIndex;
-				newClusterIndex++;
-				numClusters++;
-			}
-		} else if (clusterIndices[i1] != -1 && clusterIndices[i2] == -1) {
-			if(shortestDist < cutoff) {
-				clusterIndices[i2] = clusterIndices[i1];
-			} else { //If distance is long, put them to different clusters
-				clusterIndices[i2] = newClusterIndex;
-				newClusterIndex++;
-				numClusters++;
-			}
-		} else { //Both indices are in clusters already
-			if(clusterIndices[i1] != clusterIndices[i2] && shortestDist < cutoff) {
-				//Merge clusters
-
-				int oldClusterIndex = clusterIndices[i2];
-
-				for(int i = 0; i < numConfidentIndices; i++) {
-					if(clusterIndices[i] == oldClusterIndex) {
-						clusterIndices[i] = clusterIndices[i1];
-					}
-				}
+	for(int c = 0; c < numClusters; c++) {
+		float * sum = &sums[5*c];
+		float x = sum[0] / sum[4];
+		float y = sum[1] / sum[4];
+		float w = sum[2] / sum[4];
+		float h = sum[3] / sum[4];
 
-				numClusters--;
-			}
-		}
+		detectionResult->clusterBBs->push_back(Rect(floor(x+0.5), floor(y+0.5), floor(w+0.5), floor(h+0.5)));
 	}
+}
 
-	detectionResult->numClusters = numClusters;
+void Clustering::clusterConfidentIndices() {
+	int numConfidentIndices = detectionResult->confidentIndices->size();
+	int * clusterIndices = workingSet->alloc<int>(numConfidentIndices);
+	cluster(clusterIndices);
+	calcMeanRects(clusterIndices);
+	if(detectionResult->numClusters == 1) {
+		detectionResult->detectorBBStorage = detectionResult->clusterBBs->at(0);
+		detectionResult->detectorBB = &detectionResult->detectorBBStorage;
+		//TODO: Take the maximum confidence as the result confidence.
+	}
 }
 
 } /* namespace tld */
@@ -30,18 +30,20 @@
 #include <opencv/cv.h>
 
 #include "DetectionResult.h"
+#include "WorkingSet.h"
+#include "WindowGridCache.h"
 
 namespace tld {
 
 class Clustering {
-	void calcMeanRect(std::vector<int> * indices);
-	void calcDistances(float * distances);
-	void cluster(float * distances, int * clusterIndices);
+	void cluster(int * clusterIndices);
+	void calcMeanRects(int * clusterIndices);
 public:
-	int* windows;
+	WindowGrid* windowGrid;
 	int numWindows;
 
 	DetectionResult* detectionResult;
+	WorkingSet* workingSet;
 
 	//Configurable members
 	float cutoff;
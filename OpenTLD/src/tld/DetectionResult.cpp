@@ -23,6 +23,8 @@
  *      Author: Georg Nebehay
  */
 
+#include <cstring>
+
 #include "DetectionResult.h"
 #include "TLDUtil.h"
 
@@ -36,22 +38,28 @@ DetectionResult::DetectionResult() {
 	fgList = new vector<Rect>();
 	confidentIndices = new vector<int>();
 	numClusters = 0;
+	clusterBBs = new vector<Rect>();
 	detectorBB = NULL;
 
 	variances = NULL;
 	posteriors = NULL;
+	lowerBounds = NULL;
 	featureVectors = NULL;
 }
 
 DetectionResult::~DetectionResult() {
 	release();
+	delete fgList;
+	delete clusterBBs;
 }
 
 void DetectionResult::init(int numWindows, int numTrees) {
 	variances = new float[numWindows];
 	posteriors = new float[numWindows];
+	lowerBounds = new bool[numWindows];
+	memset(lowerBounds, 0, numWindows * sizeof(bool));
 	featureVectors = new int[numWindows*numTrees];
-	confidentIndices = new vector<int>();
+	if(confidentIndices == NULL) confidentIndices = new vector<int>();
 
 }
 
@@ -60,7 +68,7 @@ void DetectionResult::reset() {
 	if(fgList != NULL) fgList->clear();
 	if(confidentIndices != NULL) confidentIndices->clear();
 	numClusters = 0;
-	delete detectorBB;
+	clusterBBs->clear();
 	detectorBB = NULL;
 }
 
@@ -70,11 +78,13 @@ void DetectionResult::release() {
 	variances = NULL;
 	delete[] posteriors;
 	posteriors = NULL;
+	delete[] lowerBounds;
+	lowerBounds = NULL;
 	delete[] featureVectors;
 	featureVectors = NULL;
 	delete confidentIndices;
 	confidentIndices = NULL;
-	delete detectorBB;
+	clusterBBs->clear();
 	detectorBB = NULL;
 	containsValidData = false;
 }
@@ -36,11 +36,14 @@ public:
 	bool containsValidData;
 	std::vector<cv::Rect>* fgList;
 	float * posteriors; /* Contains the posteriors for each slding window. Is of size numWindows. Allocated by tldInitClassifier. */
+	bool * lowerBounds; //Whether a posterior is only a lower bound, see EnsembleClassifier::earlyExit
 	std::vector<int>* confidentIndices;
 	int * featureVectors;
 	float * variances;
 	int numClusters;
-	cv::Rect* detectorBB; //Contains a valid result only if numClusters = 1
+	std::vector<cv::Rect>* clusterBBs; //Mean bounding box of each cluster
+	cv::Rect* detectorBB; //Contains a valid result only if numClusters = 1. Points to detectorBBStorage or is NULL.
+	cv::Rect detectorBBStorage;
 
 	DetectionResult();
 	virtual ~DetectionResult();
@@ -27,14 +27,22 @@
 
 #include <algorithm>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "TLDUtil.h"
 
 using namespace cv;
 
 namespace tld {
 
-//TODO: Convert this to a function
-#define sub2idx(x,y,imgWidthStep) ((int) (floor((x)+0.5) + floor((y)+0.5)*(imgWidthStep)))
+//Number of windows detect() hands to each stage at once
+static const int TLD_DETECTOR_TILE_SIZE = 64;
+
+//Tiles per thread detectSliced() scans between two checks of the time budget
+static const int TLD_DETECTOR_BATCH_TILES = 8;
+
 
 DetectorCascade::DetectorCascade() {
 	objWidth = -1; //MUST be set before calling init
@@ -52,6 +60,22 @@ DetectorCascade::DetectorCascade() {
 	numTrees = 13;
 	numFeatures = 10;
 
+	numThreads = 0;
+	implicitWindows = false;
+	numScanSlices = 1;
+	scanTimeBudget = 0;
+	scanSlice = 0;
+	scanCursor = 0;
+	setFresh(0, 1, 0, 0);
+	scannedTogether = false;
+
+	numWindows = 0;
+	numScales = 0;
+	scales = NULL;
+	scaleGrids = NULL;
+	windowGrid = NULL;
+	windowGridCache = new WindowGridCache();
+
 	initialised = false;
 
 	foregroundDetector = new ForegroundDetector();
@@ -61,6 +85,7 @@ DetectorCascade::DetectorCascade() {
 	clustering = new Clustering();
 
 	detectionResult = new DetectionResult();
+	workingSet = new WorkingSet();
 }
 
 DetectorCascade::~DetectorCascade() {
@@ -70,7 +95,9 @@ DetectorCascade::~DetectorCascade() {
 	delete varianceFilter;
 	delete ensembleClassifier;
 	delete nnClassifier;
+	delete clustering;
 	delete detectionResult;
+	delete workingSet;
 }
 
 void DetectorCascade::init() {
@@ -79,7 +106,6 @@ void DetectorCascade::init() {
 	}
 
 	initWindowsAndScales();
-	initWindowOffsets();
 
 	propagateMembers();
 
@@ -92,15 +118,15 @@ void DetectorCascade::init() {
 void DetectorCascade::propagateMembers() {
 	detectionResult->init(numWindows, numTrees);
 
-	varianceFilter->windowOffsets = windowOffsets;
-	ensembleClassifier->windowOffsets = windowOffsets;
+	varianceFilter->windowGrid = windowGrid;
+	ensembleClassifier->windowGrid = windowGrid;
 	ensembleClassifier->imgWidthStep = imgWidthStep;
 	ensembleClassifier->numScales = numScales;
 	ensembleClassifier->scales = scales;
 	ensembleClassifier->numFeatures = numFeatures;
 	ensembleClassifier->numTrees = numTrees;
-	nnClassifier->windows = windows;
-	clustering->windows = windows;
+	nnClassifier->windowGrid = windowGrid;
+	clustering->windowGrid = windowGrid;
 	clustering->numWindows = numWindows;
 
 	foregroundDetector->minBlobSize = minSize*minSize;
@@ -110,6 +136,7 @@ void DetectorCascade::propagateMembers() {
 	ensembleClassifier->detectionResult = detectionResult;
 	nnClassifier->detectionResult = detectionResult;
 	clustering->detectionResult = detectionResult;
+	clustering->workingSet = workingSet;
 }
 
 void DetectorCascade::release() {
@@ -128,121 +155,286 @@ void DetectorCascade::release() {
 	numWindows = 0;
 	numScales = 0;
 
-	delete[] scales;
+	windowGridCache->release(windowGrid);
+	windowGrid = NULL;
 	scales = NULL;
-	delete[] windows;
-	windows = NULL;
-	delete[] windowOffsets;
-	windowOffsets = NULL;
+	scaleGrids = NULL;
 
 	objWidth = -1;
 	objHeight = -1;
 
 	detectionResult->release();
+	workingSet->release();
+	sliceIndices.clear();
 }
 
 void DetectorCascade::cleanPreviousData() {
 	detectionResult->reset();
+	workingSet->reset();
 }
 
-/* returns number of bounding boxes, bounding boxes, number of scales, scales
- * bounding boxes are stored in an array of size 5*numBBs using the format <x y w h scaleIndex>
- * scales are stored using the format <w h>
- *
- */
+//Takes the windows, their offsets and the scales for the current settings from windowGridCache
 void DetectorCascade::initWindowsAndScales() {
+	WindowGridKey key;
+	key.imgWidth = imgWidth;
+	key.imgHeight = imgHeight;
+	key.imgWidthStep = imgWidthStep;
+	key.objWidth = objWidth;
+	key.objHeight = objHeight;
+	key.minScale = minScale;
+	key.maxScale = maxScale;
+	key.minSize = minSize;
+	key.useShift = useShift;
+	key.shift = shift;
+	key.numFeatures = numFeatures;
+	key.numTrees = numTrees;
+	key.implicit = implicitWindows;
+
+	if(windowGrid != NULL) {
+		windowGridCache->release(windowGrid);
+	}
+	windowGrid = windowGridCache->acquire(key);
+
+	numWindows = windowGrid->numWindows;
+	numScales = windowGrid->numScales;
+	scales = windowGrid->scales;
+	scaleGrids = windowGrid->scaleGrids;
+}
 
-	int scanAreaX = 1; // It is important to start with 1/1, because the integral images aren't defined at pos(-1,-1) due to speed reasons
-	int scanAreaY = 1;
-	int scanAreaW = imgWidth-1;
-	int scanAreaH = imgHeight-1;
+//Rounds towards minus infinity, unlike integer division
+static int floorDiv(int a, int b) {
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+/*
+ * Appends the indices of all windows inside region to the numIndices already in indices, and
+ * returns the new number. The grid of each scale gives the range of rows and columns inside
+ * a region directly, so windows outside are never looked at.
+ */
+int DetectorCascade::findWindowsInside(const Rect& r, int * indices, int numIndices) {
+	for(int s = 0; s < numScales; s++) {
+		const ScaleGrid& grid = scaleGrids[s];
+
+		//Windows must lie strictly inside, see tldIsInside
+		int beginX = max(0, floorDiv(r.x - grid.x, grid.stepX) + 1);
+		int endX = min(grid.numX, -floorDiv(grid.x + grid.width - r.x - r.width, grid.stepX));
+		int beginY = max(0, floorDiv(r.y - grid.y, grid.stepY) + 1);
+		int endY = min(grid.numY, -floorDiv(grid.y + grid.height - r.y - r.height, grid.stepY));
+
+		for(int y = beginY; y < endY; y++) {
+			int rowStart = grid.firstWindow + y*grid.numX;
+			for(int x = beginX; x < endX; x++) {
+				indices[numIndices++] = rowStart + x;
+			}
+		}
+	}
 
-	int windowIndex = 0;
+	return numIndices;
+}
 
-    scales = new Size[maxScale-minScale+1];
+/*
+ * Writes the indices of the windows detect() scans to indices, in ascending order, and returns
+ * their number: those inside a foreground region, if there is a background model, and inside
+ * searchRegion, if given. Of these, only every numSlices-th one is kept, starting at slice.
+ * indices must have room for numWindows entries.
+ */
+int DetectorCascade::findCandidates(const Rect* searchRegion, int slice, int numSlices, int * indices) {
+	int numIndices = 0;
+
+	if(foregroundDetector->isActive()) {
+		std::vector<Rect>* fgList = detectionResult->fgList;
+		for(size_t j = 0; j < fgList->size(); j++) {
+			Rect r = (searchRegion != NULL) ? (fgList->at(j) & *searchRegion) : fgList->at(j);
+			numIndices = findWindowsInside(r, indices, numIndices);
+		}
 
-	numWindows = 0;
+		//Windows inside several regions were added more than once
+		if(fgList->size() > 1) {
+			std::sort(indices, indices + numIndices);
+			numIndices = std::unique(indices, indices + numIndices) - indices;
+		}
+	} else if(searchRegion != NULL) {
+		numIndices = findWindowsInside(*searchRegion, indices, 0);
+	} else {
+		for(int i = slice; i < numWindows; i += numSlices) {
+			indices[numIndices++] = i;
+		}
+		return numIndices;
+	}
 
-	int scaleIndex = 0;
-	for(int i = minScale; i <= maxScale; i++) {
-		float scale = pow(1.2,i);
-		int w = (int)objWidth*scale;
-		int h = (int)objHeight*scale;
-		int ssw,ssh;
-		if(useShift) {
-			ssw = max<float>(1,w*shift);
-			ssh = max<float>(1,h*shift);
-		} else {
-			ssw = 1;
-			ssh = 1;
+	if(numSlices > 1) {
+		int numKept = 0;
+		for(int n = 0; n < numIndices; n++) {
+			if(indices[n] % numSlices == slice) {
+				indices[numKept++] = indices[n];
+			}
 		}
+		numIndices = numKept;
+	}
 
-		if(w < minSize || h < minSize || w > scanAreaW || h > scanAreaH) continue;
+	return numIndices;
+}
 
-		scales[scaleIndex].width = w;
-		scales[scaleIndex].height = h;
+//frameId identifies img in the cache of the variance filter, see tldNewFrameId()
+void DetectorCascade::detect(const Mat& img, unsigned long frameId) {
+	detect(img, frameId, NULL);
+}
 
-		scaleIndex++;
+int DetectorCascade::threadCount() const {
+#ifdef _OPENMP
+	return (numThreads > 0) ? numThreads : omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
 
-		numWindows += floor((float)(scanAreaW - w + ssw)/ssw)*floor((float)(scanAreaH - h + ssh) / ssh);
-	}
+void DetectorCascade::setFresh(int slice, int numSlices, int begin, int end) {
+	freshSlice = slice;
+	freshNumSlices = numSlices;
+	freshBegin = begin;
+	freshEnd = end;
+}
 
-	numScales = scaleIndex;
+/*
+ * Whether the posterior and feature vector of a window are from the frame the detector last
+ * ran on. After detectSliced(), the windows of other slices are left over from earlier frames.
+ */
+bool DetectorCascade::isFresh(int windowIdx) const {
+	return windowIdx % freshNumSlices == freshSlice && windowIdx >= freshBegin && windowIdx < freshEnd;
+}
 
-	windows = new int[TLD_WINDOW_SIZE*numWindows];
+//Prepare components
+void DetectorCascade::nextIteration(const Mat& img, unsigned long frameId) {
+	foregroundDetector->nextIteration(img); //Calculates foreground
+	varianceFilter->nextIteration(img, frameId); //Calculates integral images
+	ensembleClassifier->nextIteration(img);
+	nnClassifier->nextIteration();
+}
 
-	for(scaleIndex = 0; scaleIndex < numScales; scaleIndex++) {
-		int w = scales[scaleIndex].width;
-		int h = scales[scaleIndex].height;
+void DetectorCascade::reserveThreadBuffers(int maxThreads) {
+	if((int) threadIndices.size() < maxThreads) {
+		threadIndices.resize(maxThreads);
+		threadMatches.resize(maxThreads);
+	}
+}
 
-		int ssw,ssh;
-		if(useShift) {
-			ssw = max<float>(1,w*shift);
-			ssh = max<float>(1,h*shift);
-		} else {
-			ssw = 1;
-			ssh = 1;
-		}
+//Stamps the NN rows the threads matched, once they are done classifying
+void DetectorCascade::touchThreadMatches(int maxThreads) {
+	for(int t = 0; t < maxThreads; t++) {
+		nnClassifier->touchMatches(threadMatches[t]);
+		threadMatches[t].clear();
+	}
+}
 
-		for(int y = scanAreaY; y + h <= scanAreaY +scanAreaH; y+=ssh) {
-			for(int x = scanAreaX; x + w <= scanAreaX + scanAreaW; x+=ssw) {
-				int * bb = &windows[TLD_WINDOW_SIZE*windowIndex];
-				tldCopyBoundaryToArray<int>(x,y,w,h, bb);
-				bb[4] = scaleIndex;
+/*
+ * Runs the cascade on candidates[begin] to candidates[end-1], or on windows begin to end-1 if
+ * candidates is NULL, and appends the windows that pass every stage to confident.
+ */
+void DetectorCascade::scanWindows(const Mat& img, const int * candidates, int begin, int end, std::vector<int>& confident) {
+	//Every window only writes its own entries of the detection result, except for the list of
+	//confident windows. Each thread collects those in its own buffer, and the buffers are merged afterwards.
+	int maxThreads = threadCount();
+	reserveThreadBuffers(maxThreads);
+
+	#pragma omp parallel num_threads(maxThreads)
+	{
+		int threadNum = 0;
+#ifdef _OPENMP
+		threadNum = omp_get_thread_num();
+#endif
+		std::vector<int>& indices = threadIndices[threadNum];
+		std::vector<int>& matches = threadMatches[threadNum];
+		indices.clear();
+		matches.clear();
+
+		//Windows are processed in tiles of neighbouring windows, so the ensemble classifier can evaluate them together
+		int numTiles = (end - begin + TLD_DETECTOR_TILE_SIZE - 1) / TLD_DETECTOR_TILE_SIZE;
+
+		#pragma omp for schedule(dynamic)
+		for (int tile = 0; tile < numTiles; tile++) {
+
+			int tileIndices[TLD_DETECTOR_TILE_SIZE];
+			int numTileIndices = 0;
+
+			int tileEnd = min(end, begin + (tile + 1) * TLD_DETECTOR_TILE_SIZE);
+			for(int n = begin + tile * TLD_DETECTOR_TILE_SIZE; n < tileEnd; n++) {
+				int i = (candidates != NULL) ? candidates[n] : n;
+
+				if(!varianceFilter->filter(i)) {
+					detectionResult->posteriors[i] = 0;
+					detectionResult->lowerBounds[i] = false;
+					continue;
+				}
 
-				windowIndex++;
+				tileIndices[numTileIndices++] = i;
 			}
-		}
 
+			numTileIndices = ensembleClassifier->filter(tileIndices, numTileIndices);
+			numTileIndices = nnClassifier->filter(img, tileIndices, numTileIndices, &matches);
+
+			indices.insert(indices.end(), tileIndices, tileIndices + numTileIndices);
+		}
 	}
 
-	assert(windowIndex == numWindows);
+	for(int t = 0; t < maxThreads; t++) {
+		confident.insert(confident.end(), threadIndices[t].begin(), threadIndices[t].end());
+		threadIndices[t].clear();
+	}
+	touchThreadMatches(maxThreads);
 }
 
-//Creates offsets that can be added to bounding boxes
-//offsets are contained in the form delta11, delta12,... (combined index of dw and dh)
-//Order: scale->tree->feature
-void DetectorCascade::initWindowOffsets() {
+//Scans only the windows inside searchRegion, if given. Windows not scanned get a posterior of 0.
+void DetectorCascade::detect(const Mat& img, unsigned long frameId, const Rect* searchRegion) {
+	//For every bounding box, the output is confidence, pattern, variance
+
+	detectionResult->reset();
+
+	if(!initialised) {
+		return;
+	}
 
-	windowOffsets = new int[TLD_WINDOW_OFFSET_SIZE*numWindows];
-	int *off = windowOffsets;
+	//Posteriors are overwritten, so what detectSliced() found before is gone
+	sliceIndices.clear();
+	setFresh(0, 1, 0, numWindows);
 
-	int windowSize = TLD_WINDOW_SIZE;
+	nextIteration(img, frameId);
 
-	for (int i = 0; i < numWindows; i++) {
+	//With a background model, only windows inside a foreground region are looked at
+	int * candidates = NULL;
+	int numCandidates = numWindows;
+	if(foregroundDetector->isActive() || searchRegion != NULL) {
+		candidates = workingSet->alloc<int>(numWindows);
+		numCandidates = findCandidates(searchRegion, 0, 1, candidates);
 
-		int *window = windows+windowSize*i;
-		*off++ = sub2idx(window[0]-1,window[1]-1,imgWidthStep); // x1-1,y1-1
-		*off++ = sub2idx(window[0]-1,window[1]+window[3]-1,imgWidthStep); // x1-1,y2
-		*off++ = sub2idx(window[0]+window[2]-1,window[1]-1,imgWidthStep); // x2,y1-1
-		*off++ = sub2idx(window[0]+window[2]-1,window[1]+window[3]-1,imgWidthStep); // x2,y2
-		*off++ = window[4]*2*numFeatures*numTrees; // pointer to features for this scale
-		*off++ = window[2]*window[3];//Area of bounding box
+		for(int i = 0; i < numWindows; i++) {
+			detectionResult->posteriors[i] = 0;
+			detectionResult->lowerBounds[i] = false;
+		}
 	}
+
+	std::vector<int>* confidentIndices = detectionResult->confidentIndices;
+	scanWindows(img, candidates, 0, numCandidates, *confidentIndices);
+
+	//The windows each thread got depend on scheduling, so sort them for a deterministic order
+	std::sort(confidentIndices->begin(), confidentIndices->end());
+
+	//Cluster
+	clustering->clusterConfidentIndices();
+
+	detectionResult->containsValidData = true;
 }
 
-void DetectorCascade::detect(const Mat& img) {
-	//For every bounding box, the output is confidence, pattern, variance
+/*
+ * Spreads a full scan over several frames: every call scans one of numScanSlices interleaved
+ * slices of the windows. With a scanTimeBudget, a slice is scanned in batches until the budget
+ * is used up, and the next call continues where this one stopped.
+ * Windows keep the posterior from when their slice was last scanned, but only the windows
+ * scanned in this call are fresh, see isFresh(). Confident windows of earlier calls are only
+ * clustered if they would join a cluster with a fresh one, so they can back up a detection in
+ * the current frame but never make one on their own.
+ */
+void DetectorCascade::detectSliced(const Mat& img, unsigned long frameId) {
+	int64 startTime = getTickCount();
 
 	detectionResult->reset();
 
@@ -250,55 +442,226 @@ void DetectorCascade::detect(const Mat& img) {
 		return;
 	}
 
-	//Prepare components
-	foregroundDetector->nextIteration(img); //Calculates foreground
-	varianceFilter->nextIteration(img); //Calculates integral images
-	ensembleClassifier->nextIteration(img);
+	int numSlices = max(1, numScanSlices);
+	if((int) sliceIndices.size() != numSlices) {
+		sliceIndices.assign(numSlices, std::vector<int>());
+		scanSlice = 0;
+		scanCursor = 0;
 
-	#pragma omp parallel for
-	for (int i = 0; i < numWindows; i++) {
+		for(int i = 0; i < numWindows; i++) {
+			detectionResult->posteriors[i] = 0;
+			detectionResult->lowerBounds[i] = false;
+		}
+	}
 
-		int * window = &windows[TLD_WINDOW_SIZE*i];
+	nextIteration(img, frameId);
 
-		if(foregroundDetector->isActive()) {
-			bool isInside = false;
+	//Scanning a slice again drops what was found in it the last time
+	if(scanCursor == 0) {
+		sliceIndices[scanSlice].clear();
 
-			for(size_t j = 0; j < detectionResult->fgList->size(); j++) {
+		for(int i = scanSlice; i < numWindows; i += numSlices) {
+			detectionResult->posteriors[i] = 0;
+			detectionResult->lowerBounds[i] = false;
+		}
+	}
 
-				int bgBox[4];
-				tldRectToArray(detectionResult->fgList->at(j), bgBox);
-				if(tldIsInside(window,bgBox)) { //TODO: This is inefficient and should be replaced by a quadtree
-					isInside = true;
-				}
-			}
+	int * candidates = workingSet->alloc<int>(numWindows);
+	int numCandidates = findCandidates(NULL, scanSlice, numSlices, candidates);
+
+	int slice = scanSlice;
+	int firstFresh = scanCursor;
+	std::vector<int>& hits = sliceIndices[slice];
+	size_t numOldHits = hits.size(); //Found in this slice by earlier calls
+
+	//At least one batch is scanned per call, so every slice gets done eventually
+	int batchSize = TLD_DETECTOR_TILE_SIZE * TLD_DETECTOR_BATCH_TILES * threadCount();
+	int begin = std::lower_bound(candidates, candidates + numCandidates, scanCursor) - candidates;
+	while(begin < numCandidates) {
+		int end = min(numCandidates, begin + batchSize);
+		scanWindows(img, candidates, begin, end, sliceIndices[scanSlice]);
+		begin = end;
+
+		if(scanTimeBudget > 0 && (getTickCount() - startTime) * 1000.0 / getTickFrequency() >= scanTimeBudget) {
+			break;
+		}
+	}
 
-			if(!isInside) {
-				detectionResult->posteriors[i] = 0;
-				continue;
+	if(begin < numCandidates) {
+		scanCursor = candidates[begin];
+		setFresh(slice, numSlices, firstFresh, scanCursor);
+	} else {
+		scanCursor = 0;
+		scanSlice = (scanSlice + 1) % numSlices;
+		setFresh(slice, numSlices, firstFresh, numWindows);
+	}
+
+	std::vector<int>* confidentIndices = detectionResult->confidentIndices;
+	confidentIndices->insert(confidentIndices->end(), hits.begin() + numOldHits, hits.end());
+	int numFreshHits = confidentIndices->size();
+
+	int buffer1[TLD_WINDOW_SIZE];
+	int buffer2[TLD_WINDOW_SIZE];
+	for(int s = 0; s < numSlices; s++) {
+		size_t numHits = (s == slice) ? numOldHits : sliceIndices[s].size();
+		for(size_t h = 0; h < numHits && numFreshHits > 0; h++) {
+			int * bb1 = windowGrid->window(sliceIndices[s][h], buffer1);
+			for(int f = 0; f < numFreshHits; f++) {
+				if(1 - tldBBOverlap(bb1, windowGrid->window((*confidentIndices)[f], buffer2)) < clustering->cutoff) {
+					confidentIndices->push_back(sliceIndices[s][h]);
+					break;
+				}
 			}
 		}
+	}
+	std::sort(confidentIndices->begin(), confidentIndices->end());
 
-		if(!varianceFilter->filter(i)) {
-			detectionResult->posteriors[i] = 0;
+	//Cluster
+	clustering->clusterConfidentIndices();
+
+	detectionResult->containsValidData = true;
+}
+
+/*
+ * Runs the detectors of several objects over img, each with the result detect(img, frameId) would give.
+ * Detectors with the same window grid are scanned in one pass over the windows: the variance of
+ * a window is calculated once for all of them, and all of their ensemble classifiers evaluate
+ * it while it is in the cache. Only the NN classifier and clustering are left to each detector.
+ * If the detectors share an IntegralImageCache, the integral images are built once as well.
+ * Detectors with a background model look at other windows, so they run detect() on their own.
+ * Objects of different sizes get different window grids, which are scanned in separate passes.
+ */
+void DetectorCascade::detectTogether(const Mat& img, unsigned long frameId, DetectorCascade* const * cascades, int numCascades) {
+	for(int c = 0; c < numCascades; c++) {
+		cascades[c]->scannedTogether = false;
+	}
+
+	for(int c = 0; c < numCascades; c++) {
+		DetectorCascade* first = cascades[c];
+		if(first->scannedTogether) continue;
+
+		if(!first->initialised || first->foregroundDetector->isActive()) {
+			first->detect(img, frameId);
+			first->scannedTogether = true;
 			continue;
 		}
 
-		if(!ensembleClassifier->filter(i)) {
-			continue;
+		//Kept by the first detector, so the list reuses its memory every frame
+		std::vector<DetectorCascade*>& group = first->groupMembers;
+		group.clear();
+		for(int d = c; d < numCascades; d++) {
+			DetectorCascade* cascade = cascades[d];
+			if(!cascade->scannedTogether && cascade->initialised && !cascade->foregroundDetector->isActive() && cascade->windowGrid == first->windowGrid) {
+				group.push_back(cascade);
+				cascade->scannedTogether = true;
+			}
 		}
 
-		if(!nnClassifier->filter(img, i)) {
-			continue;
+		detectGroup(img, frameId, group);
+	}
+}
+
+//detect(img, frameId) for initialised detectors without a background model that share their window grid
+void DetectorCascade::detectGroup(const Mat& img, unsigned long frameId, const std::vector<DetectorCascade*>& group) {
+	int numMembers = group.size();
+
+	VarianceFilter* varianceSource = NULL; //Any enabled filter has the integral images of img
+	for(int k = 0; k < numMembers; k++) {
+		DetectorCascade* cascade = group[k];
+		cascade->detectionResult->reset();
+		cascade->sliceIndices.clear();
+		cascade->setFresh(0, 1, 0, cascade->numWindows);
+		cascade->nextIteration(img, frameId);
+
+		if(varianceSource == NULL && cascade->varianceFilter->enabled) {
+			varianceSource = cascade->varianceFilter;
 		}
+	}
+
+	const WindowGrid* grid = group[0]->windowGrid;
+	int numWindows = group[0]->numWindows;
+	int maxThreads = group[0]->threadCount();
+	for(int k = 0; k < numMembers; k++) {
+		group[k]->reserveThreadBuffers(maxThreads);
+	}
+
+	//Windows of the current tile that passed the variance filter, per thread and detector,
+	//followed by how many there are per thread and detector
+	const int tileStride = numMembers * TLD_DETECTOR_TILE_SIZE;
+	int * allTileIndices = group[0]->workingSet->alloc<int>(maxThreads * (tileStride + numMembers));
+
+	#pragma omp parallel num_threads(maxThreads)
+	{
+		int threadNum = 0;
+#ifdef _OPENMP
+		threadNum = omp_get_thread_num();
+#endif
+		for(int k = 0; k < numMembers; k++) {
+			group[k]->threadIndices[threadNum].clear();
+			group[k]->threadMatches[threadNum].clear();
+		}
+
+		int * tileIndices = allTileIndices + threadNum * tileStride;
+		int * numTileIndices = allTileIndices + maxThreads * tileStride + threadNum * numMembers;
 
-		detectionResult->confidentIndices->push_back(i);
+		int numTiles = (numWindows + TLD_DETECTOR_TILE_SIZE - 1) / TLD_DETECTOR_TILE_SIZE;
 
+		#pragma omp for schedule(dynamic)
+		for (int tile = 0; tile < numTiles; tile++) {
+			std::fill(numTileIndices, numTileIndices + numMembers, 0);
+
+			int end = min(numWindows, (tile + 1) * TLD_DETECTOR_TILE_SIZE);
+			for(int i = tile * TLD_DETECTOR_TILE_SIZE; i < end; i++) {
+				float variance = 0;
+				if(varianceSource != NULL) {
+					int off[TLD_WINDOW_OFFSET_SIZE];
+					variance = varianceSource->calcVariance(grid->offsets(i, off));
+				}
 
+				for(int k = 0; k < numMembers; k++) {
+					VarianceFilter* varianceFilter = group[k]->varianceFilter;
+					DetectionResult* detectionResult = group[k]->detectionResult;
+
+					if(varianceFilter->enabled) {
+						detectionResult->variances[i] = variance;
+						if(variance < varianceFilter->minVar) {
+							detectionResult->posteriors[i] = 0;
+							detectionResult->lowerBounds[i] = false;
+							continue;
+						}
+					}
+
+					tileIndices[k * TLD_DETECTOR_TILE_SIZE + numTileIndices[k]++] = i;
+				}
+			}
+
+			for(int k = 0; k < numMembers; k++) {
+				int * indices = &tileIndices[k * TLD_DETECTOR_TILE_SIZE];
+				int count = group[k]->ensembleClassifier->filter(indices, numTileIndices[k]);
+				count = group[k]->nnClassifier->filter(img, indices, count, &group[k]->threadMatches[threadNum]);
+
+				std::vector<int>& confident = group[k]->threadIndices[threadNum];
+				confident.insert(confident.end(), indices, indices + count);
+			}
+		}
 	}
-	//Cluster
-	clustering->clusterConfidentIndices();
 
-	detectionResult->containsValidData = true;
+	for(int k = 0; k < numMembers; k++) {
+		DetectorCascade* cascade = group[k];
+
+		//The windows each thread got depend on scheduling, so sort them for a deterministic order
+		std::vector<int>* confidentIndices = cascade->detectionResult->confidentIndices;
+		for(int t = 0; t < maxThreads; t++) {
+			confidentIndices->insert(confidentIndices->end(), cascade->threadIndices[t].begin(), cascade->threadIndices[t].end());
+			cascade->threadIndices[t].clear();
+		}
+		std::sort(confidentIndices->begin(), confidentIndices->end());
+		cascade->touchThreadMatches(maxThreads);
+
+		cascade->clustering->clusterConfidentIndices();
+
+		cascade->detectionResult->containsValidData = true;
+	}
 }
 
 } /* namespace tld */
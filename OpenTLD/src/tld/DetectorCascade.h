@@ -32,18 +32,37 @@
 #include "EnsembleClassifier.h"
 #include "Clustering.h"
 #include "NNClassifier.h"
+#include "WorkingSet.h"
+#include "WindowGridCache.h"
 
 
 namespace tld {
 
-//Constants
-static const int TLD_WINDOW_SIZE = 5;
-static const int TLD_WINDOW_OFFSET_SIZE = 6;
-
 class DetectorCascade {
 	//Working data
 	int numScales;
 	cv::Size* scales;
+	std::vector<std::vector<int> > threadIndices; //Confident windows found by each thread
+	std::vector<std::vector<int> > threadMatches; //Rows of the NN model matched by each thread, see NNClassifier::filter()
+	std::vector<std::vector<int> > sliceIndices; //Confident windows of each slice when detectSliced() last scanned it
+	int scanSlice; //Slice detectSliced() scans next
+	int scanCursor; //Window of scanSlice detectSliced() continues at, if the time budget cut it short
+	int freshSlice; //The windows of freshSlice from freshBegin to freshEnd were scanned in the current frame, see isFresh()
+	int freshNumSlices;
+	int freshBegin;
+	int freshEnd;
+	bool scannedTogether; //Already handled by the running detectTogether()
+	std::vector<DetectorCascade*> groupMembers; //Detectors detectTogether() scans along with this one, this one first
+
+	int threadCount() const;
+	void setFresh(int slice, int numSlices, int begin, int end);
+	void nextIteration(const cv::Mat& img, unsigned long frameId);
+	int findWindowsInside(const cv::Rect& region, int * indices, int numIndices);
+	int findCandidates(const cv::Rect* searchRegion, int slice, int numSlices, int * indices);
+	void reserveThreadBuffers(int maxThreads);
+	void touchThreadMatches(int maxThreads);
+	void scanWindows(const cv::Mat& img, const int * candidates, int begin, int end, std::vector<int>& confident);
+	static void detectGroup(const cv::Mat& img, unsigned long frameId, const std::vector<DetectorCascade*>& group);
 public:
 	//Configurable members
 	int minScale;
@@ -53,6 +72,11 @@ public:
 	int minSize;
 	int numFeatures;
 	int numTrees;
+	int numThreads; //Threads used by detect(). 0 means the OpenMP default, 1 disables multithreading.
+	cv::Ptr<WindowGridCache> windowGridCache; //May be shared by detectors, which then share their windows
+	bool implicitWindows; //Decode windows from scaleGrids when needed instead of storing them. See WindowGrid.
+	int numScanSlices; //detectSliced() scans one of this many interleaved slices of the windows per frame
+	float scanTimeBudget; //Milliseconds detectSliced() may take per frame. 0 means no limit.
 
 	//Needed for init
 	int imgWidth;
@@ -61,9 +85,10 @@ public:
 	int objWidth;
 	int objHeight;
 
+	//Acquired from windowGridCache, and possibly used by other detectors as well, so never write to it
+	WindowGrid* windowGrid;
 	int numWindows;
-	int* windows;
-	int* windowOffsets;
+	ScaleGrid* scaleGrids; //One per scale
 
 	//State data
 	bool initialised;
@@ -76,6 +101,7 @@ public:
 	NNClassifier* nnClassifier;
 
 	DetectionResult* detectionResult;
+	WorkingSet* workingSet; //Scratch memory for the current frame, freed by cleanPreviousData()
 
 	void propagateMembers();
 
@@ -84,12 +110,15 @@ public:
 
 	void init();
 
-	void initWindowOffsets();
 	void initWindowsAndScales();
 
 	void release();
 	void cleanPreviousData();
-	void detect(const cv::Mat& img);
+	void detect(const cv::Mat& img, unsigned long frameId);
+	void detect(const cv::Mat& img, unsigned long frameId, const cv::Rect* searchRegion);
+	void detectSliced(const cv::Mat& img, unsigned long frameId);
+	bool isFresh(int windowIdx) const;
+	static void detectTogether(const cv::Mat& img, unsigned long frameId, DetectorCascade* const * cascades, int numCascades);
 };
 
 } /* namespace tld */
@@ -24,6 +24,7 @@
  */
 
 #include <cstdlib>
+#include <cstring>
 #include <math.h>
 #include <opencv/cv.h>
 
@@ -39,16 +40,25 @@ namespace tld {
 //TODO: Convert this to a function
 #define sub2idx(x,y,widthstep) ((int) (floor((x)+0.5) + floor((y)+0.5)*(widthstep)))
 
+//Maximum number of windows classifyWindows evaluates together
+static const int TLD_ENSEMBLE_BATCH_SIZE = 64;
+
+//Confidence a window needs to pass, 0.5
+static const unsigned int TLD_ENSEMBLE_THRESHOLD = 5 * TLD_POSTERIOR_SCALE;
+
 EnsembleClassifier::EnsembleClassifier() :
+	leafMemory(NULL),
 	features(NULL),
 	featureOffsets(NULL),
-	posteriors(NULL),
-	positives(NULL),
-	negatives(NULL)
+	leaves(NULL)
 {
 	numTrees=10;
 	numFeatures = 13;
 	enabled = true;
+	earlyExit = false;
+	recordChanges = false;
+	numWindowsClassified = 0;
+	numTreesEvaluated = 0;
 }
 
 EnsembleClassifier::~EnsembleClassifier() {
@@ -65,16 +75,18 @@ void EnsembleClassifier::init() {
 }
 
 void EnsembleClassifier::release() {
-	delete[] features;
+	if(modelFile.empty()) {
+		delete[] features;
+	}
 	features = NULL;
 	delete[] featureOffsets;
 	featureOffsets = NULL;
-	delete[] posteriors;
-	posteriors = NULL;
-	delete[] positives;
-	positives = NULL;
-	delete[] negatives;
-	negatives = NULL;
+	delete[] leafMemory;
+	leafMemory = NULL;
+	leaves = NULL;
+	modelFile.release();
+	leafChanged.clear();
+	changedLeaves.clear();
 }
 
 /*
@@ -113,30 +125,82 @@ void EnsembleClassifier::initFeatureOffsets() {
 }
 
 void EnsembleClassifier::initPosteriors() {
-	posteriors = new float[numTrees * numIndices];
-	positives = new int[numTrees * numIndices];
-	negatives = new int[numTrees * numIndices];
+	const size_t cacheLineSize = 64;
+	size_t size = sizeof(FernLeaf) * numTrees * numIndices;
 
-	for (int i = 0; i<numTrees; i++) {
-		for(int j = 0; j < numIndices; j++) {
-			posteriors[i*numIndices + j] = 0;
-			positives[i*numIndices + j] = 0;
-			negatives[i*numIndices + j] = 0;
-		}
-	}
+	leafMemory = new char[size + cacheLineSize];
+	leaves = (FernLeaf*) (((size_t) leafMemory + cacheLineSize - 1) & ~(cacheLineSize - 1));
+	memset(leaves, 0, size);
+}
+
+/*
+ * Uses the features and leaves of an open model file in place, which keeps the file mapped
+ * until release(). Learning writes to the leaves, which only changes the pages of this process.
+ */
+void EnsembleClassifier::useModelFile(const Ptr<ModelFile>& file) {
+	release();
+
+	const ModelFileHeader* header = file->header();
+	numTrees = header->numTrees;
+	numFeatures = header->numFeatures;
+	numIndices = 1 << numFeatures;
+
+	modelFile = file;
+	features = modelFile->features();
+	leaves = modelFile->leaves();
 }
 
 void EnsembleClassifier::nextIteration(const Mat& img) {
 	if(!enabled) return;
 
 	this->img = (const unsigned char *)img.data;
+
+	if(earlyExit) {
+		orderTrees();
+	}
+}
+
+/*
+ * Trees that can add a lot are evaluated first. That way, what the remaining trees can add
+ * at most shrinks quickly, and hopeless windows are rejected after few trees.
+ */
+void EnsembleClassifier::orderTrees() {
+	maxPosteriors.resize(numTrees);
+	treeOrder.resize(numTrees);
+	remainingBound.resize(numTrees + 1);
+
+	for(int t = 0; t < numTrees; t++) {
+		unsigned int maxPosterior = 0;
+		const FernLeaf* treeLeaves = leaves + t*numIndices;
+		for(int j = 0; j < numIndices; j++) {
+			if(treeLeaves[j].posterior > maxPosterior) maxPosterior = treeLeaves[j].posterior;
+		}
+		maxPosteriors[t] = maxPosterior;
+		treeOrder[t] = t;
+	}
+
+	//Insertion sort, there are only a few trees
+	for(int k = 1; k < numTrees; k++) {
+		int t = treeOrder[k];
+		int j = k;
+		for(; j > 0 && maxPosteriors[treeOrder[j-1]] < maxPosteriors[t]; j--) {
+			treeOrder[j] = treeOrder[j-1];
+		}
+		treeOrder[j] = t;
+	}
+
+	remainingBound[numTrees] = 0;
+	for(int k = numTrees - 1; k >= 0; k--) {
+		remainingBound[k] = remainingBound[k+1] + maxPosteriors[treeOrder[k]];
+	}
 }
 
 //Classical fern algorithm
 int EnsembleClassifier::calcFernFeature(int windowIdx, int treeIdx) {
 
 	int index = 0;
-	int *bbox = windowOffsets+ windowIdx* TLD_WINDOW_OFFSET_SIZE;
+	int buffer[TLD_WINDOW_OFFSET_SIZE];
+	int *bbox = windowGrid->offsets(windowIdx, buffer);
 	int *off = featureOffsets + bbox[4] + treeIdx*2*numFeatures; //bbox[4] is pointer to features for the current scale
 	for (int i=0; i<numFeatures; i++) {
 		index<<=1;
@@ -149,20 +213,30 @@ int EnsembleClassifier::calcFernFeature(int windowIdx, int treeIdx) {
 	return index;
 }
 
+//Fills in the features classifyWindows skipped because of earlyExit
+void EnsembleClassifier::completeFeatureVector(int windowIdx, int * featureVector) {
+	for(int i = 0; i < numTrees; i++) {
+		if(featureVector[i] < 0) {
+			featureVector[i] = calcFernFeature(windowIdx, i);
+		}
+	}
+}
+
 void EnsembleClassifier::calcFeatureVector(int windowIdx, int * featureVector) {
     for(int i = 0; i < numTrees; i++) {
     	featureVector[i] = calcFernFeature(windowIdx, i);
 	}
 }
 
+//Every tree contributes at most 0.1
 float EnsembleClassifier::calcConfidence(int * featureVector) {
-	float conf = 0.0;
+	unsigned int conf = 0;
 
 	for(int i = 0; i < numTrees; i++) {
-		conf += posteriors[i * numIndices + featureVector[i]];
+		conf += leaves[i * numIndices + featureVector[i]].posterior;
 	}
 
-	return conf;
+	return conf / (10.0f * TLD_POSTERIOR_SCALE);
 }
 
 void EnsembleClassifier::classifyWindow(int windowIdx) {
@@ -170,6 +244,137 @@ void EnsembleClassifier::classifyWindow(int windowIdx) {
 	calcFeatureVector(windowIdx, featureVector);
 
 	detectionResult->posteriors[windowIdx] = calcConfidence(featureVector);
+	detectionResult->lowerBounds[windowIdx] = false;
+}
+
+/*
+ * Same results as classifyWindow for each of the windows, but the windows are evaluated
+ * together in runs of the same scale. Within a run, every tree and feature is handled for all
+ * windows at once: they share the feature offsets, and neighbouring windows read neighbouring
+ * pixels. The comparisons are branch-free and the posteriors are summed per tree right away.
+ * With earlyExit, windows drop out of their run as soon as they cannot reach the threshold.
+ */
+void EnsembleClassifier::classifyWindows(const int * windowIndices, int count) {
+	int bases[TLD_ENSEMBLE_BATCH_SIZE];
+	int indices[TLD_ENSEMBLE_BATCH_SIZE];
+	unsigned int confidences[TLD_ENSEMBLE_BATCH_SIZE];
+	int active[TLD_ENSEMBLE_BATCH_SIZE]; //Windows of the run still evaluated
+	unsigned long treesEvaluated = 0;
+
+	int start = 0;
+	while(start < count) {
+		//Collect a run of windows of the same scale
+		int buffer[TLD_WINDOW_OFFSET_SIZE];
+		int scaleOffset = windowGrid->offsets(windowIndices[start], buffer)[4];
+		int n = 0;
+		while(start + n < count && n < TLD_ENSEMBLE_BATCH_SIZE) {
+			int * bbox = windowGrid->offsets(windowIndices[start + n], buffer);
+			if(bbox[4] != scaleOffset) break;
+			bases[n] = bbox[0];
+			confidences[n] = 0;
+			n++;
+		}
+
+		int numActive = n;
+		for(int w = 0; w < n; w++) {
+			active[w] = w;
+			detectionResult->lowerBounds[windowIndices[start + w]] = false;
+		}
+
+		if(earlyExit) {
+			for(int w = 0; w < n; w++) {
+				int* featureVector = detectionResult->featureVectors + numTrees*windowIndices[start + w];
+				for(int t = 0; t < numTrees; t++) {
+					featureVector[t] = -1;
+				}
+			}
+		}
+
+		for(int k = 0; k < numTrees && numActive > 0; k++) {
+			int t = earlyExit ? treeOrder[k] : k;
+
+			for(int a = 0; a < numActive; a++) {
+				indices[a] = 0;
+			}
+
+			int *off = featureOffsets + scaleOffset + t*2*numFeatures;
+			for(int f = 0; f < numFeatures; f++) {
+				const unsigned char* p0 = img + off[0];
+				const unsigned char* p1 = img + off[1];
+				for(int a = 0; a < numActive; a++) {
+					int base = bases[active[a]];
+					indices[a] = (indices[a] << 1) | (p0[base] > p1[base]);
+				}
+				off += 2;
+			}
+
+			const FernLeaf* treeLeaves = leaves + t*numIndices;
+			for(int a = 0; a < numActive; a++) {
+				int w = active[a];
+				detectionResult->featureVectors[numTrees*windowIndices[start + w] + t] = indices[a];
+				confidences[w] += treeLeaves[indices[a]].posterior;
+			}
+			treesEvaluated += numActive;
+
+			if(earlyExit) {
+				int numStillActive = 0;
+				for(int a = 0; a < numActive; a++) {
+					if(confidences[active[a]] + remainingBound[k+1] >= TLD_ENSEMBLE_THRESHOLD) {
+						active[numStillActive++] = active[a];
+					} else if(k + 1 < numTrees) {
+						detectionResult->lowerBounds[windowIndices[start + active[a]]] = true;
+					}
+				}
+				numActive = numStillActive;
+			}
+		}
+
+		for(int w = 0; w < n; w++) {
+			detectionResult->posteriors[windowIndices[start + w]] = confidences[w] / (10.0f * TLD_POSTERIOR_SCALE);
+		}
+
+		start += n;
+	}
+
+	#pragma omp atomic
+	numWindowsClassified += count;
+	#pragma omp atomic
+	numTreesEvaluated += treesEvaluated;
+}
+
+/*
+ * Returns the posterior of a window classified in the current iteration. If earlyExit left only
+ * a lower bound that the skipped trees could lift above minPosterior, they are evaluated first
+ * and the posterior in the detection result is made exact.
+ */
+float EnsembleClassifier::completePosterior(int windowIdx, float minPosterior) {
+	float posterior = detectionResult->posteriors[windowIdx];
+	if(!detectionResult->lowerBounds[windowIdx]) {
+		return posterior;
+	}
+
+	int* featureVector = detectionResult->featureVectors + numTrees * windowIdx;
+	unsigned int bound = 0;
+	for(int t = 0; t < numTrees; t++) {
+		if(featureVector[t] < 0) bound += maxPosteriors[t];
+	}
+
+	if(posterior + bound / (10.0f * TLD_POSTERIOR_SCALE) <= minPosterior) {
+		return posterior;
+	}
+
+	unsigned int conf = 0;
+	for(int t = 0; t < numTrees; t++) {
+		if(featureVector[t] < 0) {
+			featureVector[t] = calcFernFeature(windowIdx, t);
+			conf += leaves[t * numIndices + featureVector[t]].posterior;
+		}
+	}
+
+	posterior += conf / (10.0f * TLD_POSTERIOR_SCALE);
+	detectionResult->posteriors[windowIdx] = posterior;
+	detectionResult->lowerBounds[windowIdx] = false;
+	return posterior;
 }
 
 bool EnsembleClassifier::filter(int i)  {
@@ -180,10 +385,117 @@ bool EnsembleClassifier::filter(int i)  {
 	return true;
 }
 
+/*
+ * Batched version of filter(int). Removes the rejected windows from windowIndices,
+ * keeping the order of the others, and returns how many are left.
+ */
+int EnsembleClassifier::filter(int * windowIndices, int count) {
+	if(!enabled) return count;
+
+	classifyWindows(windowIndices, count);
+
+	int numAccepted = 0;
+	for(int k = 0; k < count; k++) {
+		if(detectionResult->posteriors[windowIndices[k]] >= 0.5) {
+			windowIndices[numAccepted++] = windowIndices[k];
+		}
+	}
+	return numAccepted;
+}
+
+float EnsembleClassifier::averageTreesEvaluated() const {
+	return (numWindowsClassified > 0) ? (float) numTreesEvaluated / numWindowsClassified : 0;
+}
+
 void EnsembleClassifier::updatePosterior(int treeIdx, int idx, int positive, int amount) {
-	int arrayIndex = treeIdx * numIndices + idx;
-	(positive) ? positives[arrayIndex] += amount : negatives[arrayIndex] += amount;
-	posteriors[arrayIndex] = ((float) positives[arrayIndex]) / (positives[arrayIndex] + negatives[arrayIndex]) / 10.0;
+	FernLeaf& leaf = leaves[treeIdx * numIndices + idx];
+	unsigned int p = leaf.positives;
+	unsigned int n = leaf.negatives;
+	(positive) ? p += amount : n += amount;
+
+	//The counts have 16 bits. Halving both keeps the posterior.
+	while(p > 0xFFFF || n > 0xFFFF) {
+		p = (p + 1) / 2;
+		n = (n + 1) / 2;
+	}
+
+	leaf.positives = p;
+	leaf.negatives = n;
+	leaf.posterior = (p + n > 0) ? (p * TLD_POSTERIOR_SCALE + (p + n) / 2) / (p + n) : 0;
+
+	if(recordChanges) {
+		int leafIdx = treeIdx * numIndices + idx;
+		if(leafChanged.empty()) {
+			leafChanged.resize(numTrees * numIndices, false);
+		}
+		if(!leafChanged[leafIdx]) {
+			leafChanged[leafIdx] = true;
+			changedLeaves.push_back(leafIdx);
+		}
+	}
+}
+
+int EnsembleClassifier::numPositives(int treeIdx, int idx) const {
+	return leaves[treeIdx * numIndices + idx].positives;
+}
+
+int EnsembleClassifier::numNegatives(int treeIdx, int idx) const {
+	return leaves[treeIdx * numIndices + idx].negatives;
+}
+
+void EnsembleClassifier::clearChanges() {
+	for(size_t i = 0; i < changedLeaves.size(); i++) {
+		leafChanged[changedLeaves[i]] = false;
+	}
+	changedLeaves.clear();
+}
+
+/*
+ * Makes this a copy of other: the same features, the same leaves and the same list of changes,
+ * wired to the same window grid and detection result. Memory is reused if the sizes match.
+ * other may be classifying at the same time, as long as no one changes its model.
+ */
+void EnsembleClassifier::copyModelFrom(const EnsembleClassifier& other) {
+	if(other.leaves == NULL) {
+		release();
+		return;
+	}
+
+	if(leaves == NULL || numTrees != other.numTrees || numFeatures != other.numFeatures || numScales != other.numScales) {
+		release();
+		numTrees = other.numTrees;
+		numFeatures = other.numFeatures;
+		numScales = other.numScales;
+		numIndices = other.numIndices;
+
+		features = new float[2 * 2 * numFeatures * numTrees];
+		featureOffsets = new int[numScales*numTrees*numFeatures*2];
+		initPosteriors();
+	}
+
+	enabled = other.enabled;
+	earlyExit = other.earlyExit;
+	imgWidthStep = other.imgWidthStep;
+	scales = other.scales;
+	windowGrid = other.windowGrid;
+	detectionResult = other.detectionResult;
+
+	//Features never change after init. Writing them anyway would unshare the pages of a mapped model file.
+	if(memcmp(features, other.features, sizeof(float) * 2 * 2 * numFeatures * numTrees) != 0) {
+		memcpy(features, other.features, sizeof(float) * 2 * 2 * numFeatures * numTrees);
+	}
+	memcpy(featureOffsets, other.featureOffsets, sizeof(int) * numScales*numTrees*numFeatures*2);
+	memcpy(leaves, other.leaves, sizeof(FernLeaf) * numTrees * numIndices);
+
+	recordChanges = other.recordChanges;
+	changedLeaves = other.changedLeaves;
+	leafChanged = other.leafChanged;
+}
+
+//Takes over the counters of other, which has been classifying in place of this
+void EnsembleClassifier::copyStatisticsFrom(const EnsembleClassifier& other) {
+	numWindowsClassified = other.numWindowsClassified;
+	numTreesEvaluated = other.numTreesEvaluated;
 }
 
 void EnsembleClassifier::updatePosteriors(int *featureVector, int positive, int amount) {
@@ -196,9 +508,11 @@ void EnsembleClassifier::updatePosteriors(int *featureVector, int positive, int
 	}
 }
 
-void EnsembleClassifier::learn(int * boundary, int positive, int * featureVector) {
+//featureVector may be a copy of the one of windowIdx, as long as img is still the image it was made from
+void EnsembleClassifier::learn(int windowIdx, int positive, int * featureVector) {
     if(!enabled) return;
 
+	completeFeatureVector(windowIdx, featureVector);
 	float conf = calcConfidence(featureVector);
 
     //Update if positive patch and confidence < 0.5 or negative and conf > 0.5
@@ -27,36 +27,72 @@
 #define ENSEMBLECLASSIFIER_H_
 
 #include <opencv/cv.h>
+#include <vector>
+
+#include "WindowGridCache.h"
+#include "ModelFile.h"
 
 namespace tld {
 
+//Posteriors are stored as fixed point numbers, TLD_POSTERIOR_SCALE meaning 1
+static const int TLD_POSTERIOR_SCALE = 0xFFFF;
+
+//A leaf of a fern: how many positive and negative examples reached it, and p/(p+n).
+//Eight bytes, so that eight leaves share a cache line.
+struct FernLeaf {
+	unsigned short positives;
+	unsigned short negatives;
+	unsigned short posterior;
+	unsigned short padding;
+};
+
 class EnsembleClassifier {
 	const unsigned char* img;
+	char* leafMemory; //Holds leaves, which is aligned to a cache line
+	cv::Ptr<ModelFile> modelFile; //Holds features and leaves instead if they were loaded by useModelFile()
+
+	//Working data for earlyExit
+	std::vector<unsigned int> maxPosteriors; //Largest posterior of each tree
+	std::vector<int> treeOrder; //Trees sorted by their largest posterior, descending
+	std::vector<unsigned int> remainingBound; //Largest sum the trees from treeOrder[k] on can add
+	std::vector<bool> leafChanged; //Whether a leaf is listed in changedLeaves
 
 	float calcConfidence(int * featureVector);
 	int calcFernFeature(int windowIdx, int treeIdx);
 	void calcFeatureVector(int windowIdx, int * featureVector);
+	void completeFeatureVector(int windowIdx, int * featureVector);
 	void updatePosteriors(int *featureVector, int positive, int amount);
+	void orderTrees();
 public:
 	bool enabled;
 
 	//Configurable members
 	int numTrees;
 	int numFeatures;
+	bool earlyExit; //Lets filter(int*, int) stop evaluating a window once it can no longer reach 0.5.
+	                //The posterior of such a window is only a lower bound, and the features of the
+	                //trees skipped are -1 in its feature vector until learn() or completePosterior()
+	                //fill them in.
+
+	//Checkpointing
+	bool recordChanges; //Lets updatePosterior() list the leaves it changes in changedLeaves
+	std::vector<int> changedLeaves; //Indices into leaves changed since the last clearChanges()
+
+	//Statistics
+	unsigned long numWindowsClassified; //By classifyWindows
+	unsigned long numTreesEvaluated; //By classifyWindows, over all windows
 
 	int imgWidthStep;
 	int numScales;
 	cv::Size* scales;
 
-	int* windowOffsets;
+	WindowGrid* windowGrid;
 	int* featureOffsets;
 	float* features;
 
 	int numIndices;
 
-	float * posteriors;
-	int * positives;
-	int * negatives;
+	FernLeaf* leaves; //numIndices leaves per tree
 
 	DetectionResult * detectionResult;
 
@@ -66,12 +102,22 @@ public:
 	void initFeatureLocations();
 	void initFeatureOffsets();
 	void initPosteriors();
+	void useModelFile(const cv::Ptr<ModelFile>& file);
 	void release();
 	void nextIteration(const cv::Mat& img);
 	void classifyWindow(int windowIdx);
+	void classifyWindows(const int * windowIndices, int count);
 	void updatePosterior(int treeIdx, int idx, int positive, int amount);
-	void learn(int * boundary, int positive, int * featureVector);
+	int numPositives(int treeIdx, int idx) const;
+	int numNegatives(int treeIdx, int idx) const;
+	void clearChanges();
+	void copyModelFrom(const EnsembleClassifier& other);
+	void copyStatisticsFrom(const EnsembleClassifier& other);
+	void learn(int windowIdx, int positive, int * featureVector);
+	float completePosterior(int windowIdx, float minPosterior);
 	bool filter(int i);
+	int filter(int * windowIndices, int count);
+	float averageTreesEvaluated() const;
 };
 
 } /* namespace tld */
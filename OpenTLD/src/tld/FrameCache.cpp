@@ -0,0 +1,40 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * FrameCache.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "FrameCache.h"
+
+namespace tld {
+
+//Returns an id for a new frame, never returned before, by which FrameCaches tell frames apart
+unsigned long tldNewFrameId() {
+	static unsigned long lastFrameId = 0;
+
+	unsigned long frameId;
+	#pragma omp critical(tldNewFrameId)
+	frameId = ++lastFrameId;
+
+	return frameId;
+}
+
+} /* namespace tld */
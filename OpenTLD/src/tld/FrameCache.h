@@ -0,0 +1,187 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * FrameCache.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef FRAMECACHE_H_
+#define FRAMECACHE_H_
+
+#include <opencv/cv.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace tld {
+
+unsigned long tldNewFrameId();
+
+/*
+ * Keeps something computed from each of the most recent frames, such as its LK pyramid, so
+ * that it is computed once per frame even if several trackers or detectors need it. They then
+ * share one cache.
+ *
+ * Frames are identified by the id their caller gives them, see tldNewFrameId(), never by their
+ * image data, as a caller may well reuse one buffer for every frame.
+ *
+ * T is default-constructed and then rebuilt for frame after frame by T::build(const cv::Mat&),
+ * so it can keep its buffers.
+ */
+template <class T>
+class FrameCache {
+public:
+	class Entry {
+		friend class FrameCache;
+
+		unsigned long frameId;
+		bool ready;        //Whether product has been built for frameId. Guarded by lock.
+		int users;         //Number of acquire calls not yet released
+		unsigned long lastUse;
+#ifdef _OPENMP
+		omp_lock_t lock;
+#endif
+
+		Entry() {
+			users = 0;
+#ifdef _OPENMP
+			omp_init_lock(&lock);
+#endif
+		}
+
+		~Entry() {
+#ifdef _OPENMP
+			omp_destroy_lock(&lock);
+#endif
+		}
+
+		Entry(const Entry&);
+		Entry& operator=(const Entry&);
+	public:
+		T product; //Only valid after build()
+	};
+
+	//Configurable members
+	int capacity; //Number of unused entries kept
+
+	explicit FrameCache(int capacity) {
+		this->capacity = capacity;
+		useCounter = 0;
+#ifdef _OPENMP
+		omp_init_lock(&entriesLock);
+#endif
+	}
+
+	~FrameCache() {
+		for(size_t i = 0; i < entries.size(); i++) {
+			delete entries[i];
+		}
+#ifdef _OPENMP
+		omp_destroy_lock(&entriesLock);
+#endif
+	}
+
+	/*
+	 * Returns the entry for frameId, creating it if necessary. If the cache is full, the least
+	 * recently used entry nobody has acquired is reused. The entry stays valid until it is
+	 * released. Call build() before using its product.
+	 */
+	Entry* acquire(unsigned long frameId) {
+#ifdef _OPENMP
+		omp_set_lock(&entriesLock);
+#endif
+
+		Entry* entry = NULL;
+		Entry* victim = NULL;
+
+		for(size_t i = 0; i < entries.size(); i++) {
+			Entry* e = entries[i];
+			if(e->frameId == frameId) {
+				entry = e;
+				break;
+			}
+			if(e->users == 0 && (victim == NULL || e->lastUse < victim->lastUse))
+				victim = e;
+		}
+
+		if(entry == NULL) {
+			if(victim == NULL || (int) entries.size() < capacity) {
+				victim = new Entry();
+				entries.push_back(victim);
+			}
+
+			victim->frameId = frameId;
+			victim->ready = false;
+			entry = victim;
+		}
+
+		entry->users++;
+		entry->lastUse = ++useCounter;
+
+#ifdef _OPENMP
+		omp_unset_lock(&entriesLock);
+#endif
+		return entry;
+	}
+
+	void release(Entry* entry) {
+#ifdef _OPENMP
+		omp_set_lock(&entriesLock);
+#endif
+		entry->users--;
+#ifdef _OPENMP
+		omp_unset_lock(&entriesLock);
+#endif
+	}
+
+	/*
+	 * Builds the product of entry from img, the frame it was acquired for, unless that has been
+	 * done already. Of the callers sharing the entry, the first one builds it and the others
+	 * wait for it; nobody else is held up.
+	 */
+	void build(Entry* entry, const cv::Mat& img) {
+#ifdef _OPENMP
+		omp_set_lock(&entry->lock);
+#endif
+		if(!entry->ready) {
+			entry->product.build(img);
+			entry->ready = true;
+		}
+#ifdef _OPENMP
+		omp_unset_lock(&entry->lock);
+#endif
+	}
+
+private:
+	std::vector<Entry*> entries;
+	unsigned long useCounter;
+
+#ifdef _OPENMP
+	omp_lock_t entriesLock;
+#endif
+
+	FrameCache(const FrameCache&);
+	FrameCache& operator=(const FrameCache&);
+};
+
+} /* namespace tld */
+#endif /* FRAMECACHE_H_ */
@@ -0,0 +1,135 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * IntegralImage.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "IntegralImage.h"
+
+#include <climits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TLD_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace cv;
+
+namespace tld {
+
+#ifdef TLD_USE_SSE2
+//Inclusive prefix sum of the four 32 bit lanes
+static inline __m128i prefixSum(__m128i x) {
+	x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+	return _mm_add_epi32(x, _mm_slli_si128(x, 8));
+}
+
+//The last lane, copied to all four
+static inline __m128i lastLane(__m128i x) {
+	return _mm_shuffle_epi32(x, _MM_SHUFFLE(3,3,3,3));
+}
+
+//Stores four non-negative 32 bit values as 64 bit values, adding those above
+static inline void storeSquared(long long* out, const long long* above, __m128i x) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = _mm_unpacklo_epi32(x, zero);
+	__m128i hi = _mm_unpackhi_epi32(x, zero);
+	if(above != NULL) {
+		lo = _mm_add_epi64(lo, _mm_loadu_si128((const __m128i*)above));
+		hi = _mm_add_epi64(hi, _mm_loadu_si128((const __m128i*)(above + 2)));
+	}
+	_mm_storeu_si128((__m128i*)out, lo);
+	_mm_storeu_si128((__m128i*)(out + 2), hi);
+}
+#endif
+
+/*
+ * Each row is read once. The running sums of the current row are added to the
+ * row above, so both tables are written strictly row by row.
+ * The SSE2 path keeps the squared row sums in 32 bits, which holds for rows of
+ * up to INT_MAX/(255*255) pixels; wider images use the scalar path.
+ */
+void tldCalcIntImgs(const Mat& img, IntegralImage<int>* intImg, IntegralImage<long long>* squaredIntImg) {
+	const int width = img.cols;
+	const int height = img.rows;
+
+#ifdef TLD_USE_SSE2
+	const bool useSSE = width <= INT_MAX / (255*255);
+	const __m128i zero = _mm_setzero_si128();
+#endif
+
+	for(int y = 0; y < height; y++) {
+		const unsigned char* input = img.ptr<unsigned char>(y);
+		int* output = intImg->data + width * y;
+		long long* squaredOutput = squaredIntImg->data + width * y;
+		const int* above = (y > 0) ? output - width : NULL;
+		const long long* squaredAbove = (y > 0) ? squaredOutput - width : NULL;
+
+		int x = 0;
+		int rowSum = 0;
+		long long squaredRowSum = 0;
+
+#ifdef TLD_USE_SSE2
+		if(useSSE) {
+			__m128i sum = zero;
+			__m128i squaredSum = zero;
+
+			for(; x + 8 <= width; x += 8) {
+				__m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(input + x)), zero);
+				__m128i lo = _mm_unpacklo_epi16(pixels, zero);
+				__m128i hi = _mm_unpackhi_epi16(pixels, zero);
+
+				//Every lane holds a pixel in its low 16 bits, so madd yields its square
+				__m128i squaredLo = _mm_add_epi32(prefixSum(_mm_madd_epi16(lo, lo)), squaredSum);
+				__m128i squaredHi = _mm_add_epi32(prefixSum(_mm_madd_epi16(hi, hi)), lastLane(squaredLo));
+				squaredSum = lastLane(squaredHi);
+
+				lo = _mm_add_epi32(prefixSum(lo), sum);
+				hi = _mm_add_epi32(prefixSum(hi), lastLane(lo));
+				sum = lastLane(hi);
+
+				if(above != NULL) {
+					lo = _mm_add_epi32(lo, _mm_loadu_si128((const __m128i*)(above + x)));
+					hi = _mm_add_epi32(hi, _mm_loadu_si128((const __m128i*)(above + x + 4)));
+				}
+				_mm_storeu_si128((__m128i*)(output + x), lo);
+				_mm_storeu_si128((__m128i*)(output + x + 4), hi);
+
+				storeSquared(squaredOutput + x, (squaredAbove != NULL) ? squaredAbove + x : NULL, squaredLo);
+				storeSquared(squaredOutput + x + 4, (squaredAbove != NULL) ? squaredAbove + x + 4 : NULL, squaredHi);
+			}
+
+			rowSum = _mm_cvtsi128_si32(sum);
+			squaredRowSum = _mm_cvtsi128_si32(squaredSum);
+		}
+#endif
+
+		for(; x < width; x++) {
+			int value = input[x];
+			rowSum += value;
+			squaredRowSum += value*value;
+			output[x] = (above != NULL) ? above[x] + rowSum : rowSum;
+			squaredOutput[x] = (squaredAbove != NULL) ? squaredAbove[x] + squaredRowSum : squaredRowSum;
+		}
+	}
+}
+
+} /* namespace tld */
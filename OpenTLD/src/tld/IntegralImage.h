@@ -39,6 +39,8 @@ public:
 	int height;
 
 	IntegralImage(cv::Size size) {
+		width = size.width;
+		height = size.height;
 		data = new T[size.width*size.height];
 	}
 
@@ -46,26 +48,35 @@ public:
 		delete[] data;
 	}
 
+	bool hasSize(cv::Size size) const {
+		return width == size.width && height == size.height;
+	}
+
 	void calcIntImg(const cv::Mat& img, bool squared = false)
 	{
-		const unsigned char *input = (const unsigned char*)(img.data);
-		T *output = data;
-		for(int i = 0;i < img.cols;i++){
-			for(int j = 0;j < img.rows;j++){
-				T A = (i > 0) ? output[img.cols * j + i - 1] : 0;
-				T B = (j > 0) ? output[img.cols * (j - 1) + i] : 0;
-				T C = (j > 0 && i > 0) ? output[img.cols * (j - 1) + i - 1] : 0;
-				T value = input[img.step * j + i];
+		//Row by row, keeping a running sum of the current row
+		for(int j = 0;j < img.rows;j++){
+			const unsigned char *input = img.ptr<unsigned char>(j);
+			T *output = data + img.cols * j;
+			const T *above = (j > 0) ? output - img.cols : NULL;
+			T rowSum = 0;
+			for(int i = 0;i < img.cols;i++){
+				T value = input[i];
 				if(squared) {
 					value = value*value;
 				}
-				output[img.cols * j + i] = A + B - C + value;
+				rowSum += value;
+				output[i] = (j > 0) ? above[i] + rowSum : rowSum;
 			}
 		}
 
 	}
 };
 
+/* Calculates both the integral image and the squared integral image of img in a single pass.
+ * Uses SSE2 where available. Both must have the size of img. */
+void tldCalcIntImgs(const cv::Mat& img, IntegralImage<int>* intImg, IntegralImage<long long>* squaredIntImg);
+
 
 } /* namespace tld */
 #endif /* INTEGRALIMAGE_H_ */
@@ -0,0 +1,57 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * IntegralImageCache.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "IntegralImageCache.h"
+
+using namespace cv;
+
+namespace tld {
+
+IntegralImages::IntegralImages() {
+	integralImg = NULL;
+	integralImg_squared = NULL;
+}
+
+IntegralImages::~IntegralImages() {
+	delete integralImg;
+	delete integralImg_squared;
+}
+
+//Keeps the buffers if they have the right size
+void IntegralImages::build(const Mat& img) {
+	if(integralImg != NULL && !integralImg->hasSize(img.size())) {
+		delete integralImg;
+		delete integralImg_squared;
+		integralImg = NULL;
+		integralImg_squared = NULL;
+	}
+	if(integralImg == NULL) {
+		integralImg = new IntegralImage<int>(img.size());
+		integralImg_squared = new IntegralImage<long long>(img.size());
+	}
+
+	tldCalcIntImgs(img, integralImg, integralImg_squared);
+}
+
+} /* namespace tld */
@@ -0,0 +1,58 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * IntegralImageCache.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef INTEGRALIMAGECACHE_H_
+#define INTEGRALIMAGECACHE_H_
+
+#include <opencv/cv.h>
+
+#include "IntegralImage.h"
+#include "FrameCache.h"
+
+namespace tld {
+
+//Both integral images of a frame, as the variance filter uses them
+class IntegralImages {
+	IntegralImages(const IntegralImages&);
+	IntegralImages& operator=(const IntegralImages&);
+public:
+	IntegralImage<int>* integralImg;
+	IntegralImage<long long>* integralImg_squared;
+
+	IntegralImages();
+	~IntegralImages();
+	void build(const cv::Mat& img);
+};
+
+/*
+ * Keeps the integral images of the most recent frames, so that detectors working on the same
+ * frames share them and each frame's integral images are built once.
+ */
+class IntegralImageCache : public FrameCache<IntegralImages> {
+public:
+	IntegralImageCache() : FrameCache<IntegralImages>(1) {} //The current frame
+};
+
+} /* namespace tld */
+#endif /* INTEGRALIMAGECACHE_H_ */
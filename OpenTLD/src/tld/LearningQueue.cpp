@@ -0,0 +1,141 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * LearningQueue.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "LearningQueue.h"
+
+namespace tld {
+
+LearningQueue::LearningQueue() {
+	capacity = 4;
+
+#ifdef _OPENMP
+	omp_init_lock(&jobsLock);
+#endif
+}
+
+LearningQueue::~LearningQueue() {
+	for(size_t i = 0; i < allJobs.size(); i++) {
+		delete allJobs[i];
+	}
+
+#ifdef _OPENMP
+	omp_destroy_lock(&jobsLock);
+#endif
+}
+
+//Returns a job to fill and push(). It may hold data of an earlier frame.
+LearningJob* LearningQueue::newJob() {
+	LearningJob* job;
+
+#ifdef _OPENMP
+	omp_set_lock(&jobsLock);
+#endif
+
+	if(freeJobs.empty()) {
+		job = new LearningJob();
+		allJobs.push_back(job);
+	} else {
+		job = freeJobs.back();
+		freeJobs.pop_back();
+	}
+
+#ifdef _OPENMP
+	omp_unset_lock(&jobsLock);
+#endif
+
+	return job;
+}
+
+void LearningQueue::push(LearningJob* job) {
+#ifdef _OPENMP
+	omp_set_lock(&jobsLock);
+#endif
+
+	if((int) jobs.size() >= capacity && !jobs.empty()) {
+		//The worker is falling behind; the oldest frame matters least
+		jobs.front()->img.release();
+		freeJobs.push_back(jobs.front());
+		jobs.erase(jobs.begin());
+	}
+
+	jobs.push_back(job);
+
+#ifdef _OPENMP
+	omp_unset_lock(&jobsLock);
+#endif
+}
+
+//Removes the oldest job from the queue and returns it, or NULL if there is none. Recycle it once learned.
+LearningJob* LearningQueue::take() {
+	LearningJob* job = NULL;
+
+#ifdef _OPENMP
+	omp_set_lock(&jobsLock);
+#endif
+
+	if(!jobs.empty()) {
+		job = jobs.front();
+		jobs.erase(jobs.begin());
+	}
+
+#ifdef _OPENMP
+	omp_unset_lock(&jobsLock);
+#endif
+
+	return job;
+}
+
+//Lets newJob() hand out job again. Its frame is released.
+void LearningQueue::recycle(LearningJob* job) {
+	job->img.release();
+
+#ifdef _OPENMP
+	omp_set_lock(&jobsLock);
+#endif
+
+	freeJobs.push_back(job);
+
+#ifdef _OPENMP
+	omp_unset_lock(&jobsLock);
+#endif
+}
+
+//Recycles the jobs waiting
+void LearningQueue::clear() {
+#ifdef _OPENMP
+	omp_set_lock(&jobsLock);
+#endif
+
+	for(size_t i = 0; i < jobs.size(); i++) {
+		jobs[i]->img.release();
+	}
+	freeJobs.insert(freeJobs.end(), jobs.begin(), jobs.end());
+	jobs.clear();
+
+#ifdef _OPENMP
+	omp_unset_lock(&jobsLock);
+#endif
+}
+
+} /* namespace tld */
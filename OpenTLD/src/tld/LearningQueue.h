@@ -0,0 +1,82 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * LearningQueue.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef LEARNINGQUEUE_H_
+#define LEARNINGQUEUE_H_
+
+#include <opencv/cv.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace tld {
+
+/*
+ * What TLD needs to learn from a frame: the frame, the object's box in it, and the windows
+ * picked from the detection result of that frame, with their feature vectors.
+ * Jobs are reused, see LearningQueue::newJob(), so filling one only allocates while its
+ * vectors grow.
+ */
+struct LearningJob {
+	cv::Mat img; //Shares the data of the frame
+	cv::Rect bb;
+	std::vector<int> positiveIndices; //Windows the ensemble classifier learns as positives, best overlap first
+	std::vector<int> negativeIndices; //Windows the ensemble classifier learns as negatives
+	std::vector<int> negativeIndicesForNN; //Windows the NN classifier learns as negatives
+	std::vector<int> featureVectors; //numTrees per window of negativeIndices, then of positiveIndices
+};
+
+/*
+ * Jobs the frame loop hands to the learning worker. Pushing and taking may happen at the same time.
+ * The queue owns all jobs: newJob() hands out a recycled one while there is one.
+ */
+class LearningQueue {
+	std::vector<LearningJob*> jobs; //Pushed, oldest first
+	std::vector<LearningJob*> freeJobs; //Recycled
+	std::vector<LearningJob*> allJobs;
+
+#ifdef _OPENMP
+	omp_lock_t jobsLock;
+#endif
+
+	LearningQueue(const LearningQueue&);
+	LearningQueue& operator=(const LearningQueue&);
+public:
+	//Configurable members
+	int capacity; //Number of jobs kept waiting. Pushing more drops the oldest one.
+
+	LearningQueue();
+	~LearningQueue();
+
+	LearningJob* newJob();
+	void push(LearningJob* job);
+	LearningJob* take();
+	void recycle(LearningJob* job);
+	void clear();
+};
+
+} /* namespace tld */
+#endif /* LEARNINGQUEUE_H_ */
@@ -33,18 +33,21 @@ namespace tld {
 
 MedianFlowTracker::MedianFlowTracker() {
 	trackerBB = NULL;
+	initLKContext(&lkContext);
+	pyramidCache = new PyramidCache();
 }
 
 MedianFlowTracker::~MedianFlowTracker() {
 	cleanPreviousData();
+	releaseLKContext(&lkContext);
 }
 
 void MedianFlowTracker::cleanPreviousData() {
-	delete trackerBB;
 	trackerBB = NULL;
 }
 
-void MedianFlowTracker::track(const Mat& prevMat, const Mat& currMat, Rect* prevBB) {
+//The frame ids identify the images in pyramidCache, see tldNewFrameId()
+void MedianFlowTracker::track(const Mat& prevMat, unsigned long prevFrameId, const Mat& currMat, unsigned long currFrameId, Rect* prevBB) {
 	if(prevBB != NULL) {
 		if(prevBB->width <= 0 || prevBB->height <= 0) {
 			return;
@@ -55,7 +58,18 @@ void MedianFlowTracker::track(const Mat& prevMat, const Mat& currMat, Rect* prev
 		IplImage prevImg = prevMat;
 		IplImage currImg = currMat;
 
-		int success = fbtrack(&prevImg, &currImg, bb_tracker,bb_tracker,&scale);
+		//The pyramid of currMat is built by whichever tracker sharing the cache gets here first,
+		//the others wait for it, but track on their own. Next frame, it is reused as the pyramid of prevMat.
+		PyramidCache::Entry* prevPyr = pyramidCache->acquire(prevFrameId);
+		PyramidCache::Entry* currPyr = pyramidCache->acquire(currFrameId);
+		pyramidCache->build(prevPyr, prevMat);
+		pyramidCache->build(currPyr, currMat);
+
+		int success = fbtrack(&lkContext, &prevImg, &currImg, prevPyr->product.pyr, currPyr->product.pyr,
+				CV_LKFLOW_PYR_A_READY | CV_LKFLOW_PYR_B_READY, bb_tracker,bb_tracker,&scale);
+
+		pyramidCache->release(prevPyr);
+		pyramidCache->release(currPyr);
 
 		//Extract subimage
 		float x,y,w,h;
@@ -68,7 +82,8 @@ void MedianFlowTracker::track(const Mat& prevMat, const Mat& currMat, Rect* prev
 		if(!success || x < 0 || y < 0 || w <= 0 || h <= 0 || x +w > currMat.cols || y+h > currMat.rows || x!=x || y!=y || w!=w || h!=h) { //x!=x is check for nan
 			//Leave it empty
 		} else {
-			trackerBB = new Rect(x,y,w,h);
+			trackerBBStorage = Rect(x,y,w,h);
+			trackerBB = &trackerBBStorage;
 		}
 	}
 }
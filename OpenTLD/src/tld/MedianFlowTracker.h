@@ -27,17 +27,27 @@
 #define MEDIANFLOWTRACKER_H_
 
 #include <opencv/cv.h>
+#include "lk.h"
+#include "PyramidCache.h"
 
 namespace tld {
 
 class MedianFlowTracker {
+	//Working data, reused across frames
+	LKContext lkContext;
+	MedianFlowTracker(const MedianFlowTracker&);
+	MedianFlowTracker& operator=(const MedianFlowTracker&);
 public:
-	cv::Rect* trackerBB;
+	//Configurable members
+	cv::Ptr<PyramidCache> pyramidCache; //May be shared by trackers working on the same frames
+
+	cv::Rect* trackerBB; //Points to trackerBBStorage or is NULL
+	cv::Rect trackerBBStorage;
 
 	MedianFlowTracker();
 	virtual ~MedianFlowTracker();
 	void cleanPreviousData();
-	void track(const cv::Mat& prevImg, const cv::Mat& currImg, cv::Rect* prevBB);
+	void track(const cv::Mat& prevImg, unsigned long prevFrameId, const cv::Mat& currImg, unsigned long currFrameId, cv::Rect* prevBB);
 };
 
 } /* namespace tld */
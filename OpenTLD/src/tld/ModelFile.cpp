@@ -0,0 +1,309 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * ModelFile.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "ModelFile.h"
+#include "DetectorCascade.h"
+#include "TLDUtil.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tld {
+
+static const char TLD_MODEL_FILE_MAGIC[8] = {'T','L','D','M','O','D','E','L'};
+static const unsigned int TLD_MODEL_FILE_BYTE_ORDER = 0x01020304;
+static const unsigned int TLD_MODEL_FILE_ALIGNMENT = 64;
+
+//Bytes covered by the checksum start right after it
+static const size_t checksumStart = offsetof(ModelFileHeader, checksum) + sizeof(unsigned int);
+
+static unsigned int alignOffset(unsigned int offset) {
+	return (offset + TLD_MODEL_FILE_ALIGNMENT - 1) & ~(TLD_MODEL_FILE_ALIGNMENT - 1);
+}
+
+static int numLeaves(const ModelFileHeader* h) {
+	return h->numTrees * (1 << h->numFeatures);
+}
+
+//Checks that a section of count elements of elementSize bytes lies within the file and is aligned
+static bool sectionFits(unsigned int offset, size_t count, size_t elementSize, size_t fileSize) {
+	if(offset % TLD_MODEL_FILE_ALIGNMENT != 0 || offset < sizeof(ModelFileHeader) || offset > fileSize) {
+		return false;
+	}
+	return count <= (fileSize - offset) / elementSize;
+}
+
+//Renames from to to, replacing to if it exists. Mappings of the old to stay valid.
+static bool replaceFile(const char* from, const char* to) {
+#ifdef _WIN32
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from, to) == 0;
+#endif
+}
+
+ModelFile::ModelFile() {
+	data = NULL;
+	size = 0;
+	fileHandle = NULL;
+	mappingHandle = NULL;
+}
+
+ModelFile::~ModelFile() {
+	close();
+}
+
+/*
+ * Maps the file at path copy-on-write and checks its header, sections and checksum.
+ * Returns false and leaves the object closed if the file cannot be used.
+ */
+bool ModelFile::open(const char* path) {
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		printf("Error: Unable to open model file %s\n", path);
+		return false;
+	}
+	fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG) sizeof(ModelFileHeader) || fileSize.HighPart != 0) {
+		printf("Error: %s is not a model file\n", path);
+		close();
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if(mapping == NULL) {
+		printf("Error: Unable to map model file %s\n", path);
+		close();
+		return false;
+	}
+	mappingHandle = mapping;
+
+	data = (char*) MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if(data == NULL) {
+		printf("Error: Unable to map model file %s\n", path);
+		close();
+		return false;
+	}
+	size = (size_t) fileSize.QuadPart;
+#else
+	int fd = ::open(path, O_RDONLY);
+	if(fd < 0) {
+		printf("Error: Unable to open model file %s\n", path);
+		return false;
+	}
+
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t) sizeof(ModelFileHeader)) {
+		printf("Error: %s is not a model file\n", path);
+		::close(fd);
+		return false;
+	}
+
+	//The mapping stays valid once the descriptor is closed
+	void* mapped = mmap(NULL, (size_t) fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(mapped == MAP_FAILED) {
+		printf("Error: Unable to map model file %s\n", path);
+		return false;
+	}
+	data = (char*) mapped;
+	size = (size_t) fileStat.st_size;
+#endif
+
+	const ModelFileHeader* h = header();
+	bool valid = memcmp(h->magic, TLD_MODEL_FILE_MAGIC, sizeof(TLD_MODEL_FILE_MAGIC)) == 0
+			&& h->version == TLD_MODEL_FILE_VERSION
+			&& h->byteOrder == TLD_MODEL_FILE_BYTE_ORDER
+			&& h->fileSize == size
+			&& h->patchSize == TLD_PATCH_SIZE
+			&& h->numTrees > 0 && h->numFeatures > 0 && h->numFeatures <= 16
+			&& h->numTruePositives >= 0 && h->numFalsePositives >= 0;
+
+	if(!valid) {
+		printf("Error: %s is not a model file of version %u\n", path, TLD_MODEL_FILE_VERSION);
+		close();
+		return false;
+	}
+
+	const size_t patchBytes = sizeof(float)*TLD_PATCH_SIZE*TLD_PATCH_SIZE;
+
+	valid = sectionFits(h->featuresOffset, (size_t) 4*h->numFeatures*h->numTrees, sizeof(float), size)
+			&& sectionFits(h->truePositivesOffset, h->numTruePositives, patchBytes, size)
+			&& sectionFits(h->falsePositivesOffset, h->numFalsePositives, patchBytes, size)
+			&& sectionFits(h->leavesOffset, numLeaves(h), sizeof(FernLeaf), size);
+
+	if(!valid || tldAdler32(1, data + checksumStart, size - checksumStart) != h->checksum) {
+		printf("Error: Model file %s is corrupt\n", path);
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void ModelFile::close() {
+#ifdef _WIN32
+	if(data != NULL) UnmapViewOfFile(data);
+	if(mappingHandle != NULL) CloseHandle(mappingHandle);
+	if(fileHandle != NULL) CloseHandle(fileHandle);
+#else
+	if(data != NULL) munmap(data, size);
+#endif
+
+	data = NULL;
+	size = 0;
+	fileHandle = NULL;
+	mappingHandle = NULL;
+}
+
+const ModelFileHeader* ModelFile::header() const {
+	return (const ModelFileHeader*) data;
+}
+
+float* ModelFile::features() {
+	return (float*) (data + header()->featuresOffset);
+}
+
+const float* ModelFile::truePositives() const {
+	return (const float*) (data + header()->truePositivesOffset);
+}
+
+const float* ModelFile::falsePositives() const {
+	return (const float*) (data + header()->falsePositivesOffset);
+}
+
+FernLeaf* ModelFile::leaves() {
+	return (FernLeaf*) (data + header()->leavesOffset);
+}
+
+//Writes data to file while accumulating the checksum; pads up to offset first
+class ModelFileWriter {
+public:
+	FILE* file;
+	unsigned int position;
+	unsigned int checksum;
+	bool ok;
+
+	ModelFileWriter(FILE* f) : file(f), position(sizeof(ModelFileHeader)), checksum(1), ok(true) {}
+
+	void seek(unsigned int offset) {
+		static const char zeros[TLD_MODEL_FILE_ALIGNMENT] = {0};
+		while(position < offset) {
+			unsigned int n = offset - position;
+			if(n > TLD_MODEL_FILE_ALIGNMENT) n = TLD_MODEL_FILE_ALIGNMENT;
+			write(zeros, n);
+		}
+	}
+
+	void write(const void* bytes, size_t n) {
+		checksum = tldAdler32(checksum, bytes, n);
+		ok = ok && fwrite(bytes, 1, n, file) == n;
+		position += (unsigned int) n;
+	}
+};
+
+/*
+ * Writes a model file. description supplies objWidth, objHeight, minVar, numTrees and numFeatures;
+ * everything else in the header is filled in here.
+ */
+bool ModelFile::write(const char* path, const ModelFileHeader& description, const float* features,
+		const std::vector<NormalizedPatch>& truePositives, const std::vector<NormalizedPatch>& falsePositives,
+		const FernLeaf* leaves) {
+	ModelFileHeader h = description;
+	memcpy(h.magic, TLD_MODEL_FILE_MAGIC, sizeof(TLD_MODEL_FILE_MAGIC));
+	h.version = TLD_MODEL_FILE_VERSION;
+	h.byteOrder = TLD_MODEL_FILE_BYTE_ORDER;
+	h.patchSize = TLD_PATCH_SIZE;
+	h.numTruePositives = (int) truePositives.size();
+	h.numFalsePositives = (int) falsePositives.size();
+
+	const unsigned int patchBytes = sizeof(float)*TLD_PATCH_SIZE*TLD_PATCH_SIZE;
+
+	h.featuresOffset = alignOffset(sizeof(ModelFileHeader));
+	h.truePositivesOffset = alignOffset(h.featuresOffset + sizeof(float)*4*h.numFeatures*h.numTrees);
+	h.falsePositivesOffset = alignOffset(h.truePositivesOffset + patchBytes*h.numTruePositives);
+	h.leavesOffset = alignOffset(h.falsePositivesOffset + patchBytes*h.numFalsePositives);
+	h.fileSize = h.leavesOffset + sizeof(FernLeaf)*numLeaves(&h);
+	h.checksum = 0;
+
+	//Truncating a file others have mapped would pull the pages from under them,
+	//so the model is written next to it and then replaces it
+	std::string tempPath = std::string(path) + ".tmp";
+	FILE* file = fopen(tempPath.c_str(), "wb");
+	if(file == NULL) {
+		printf("Error: Unable to write model file %s\n", path);
+		return false;
+	}
+
+	//The header goes in twice: first as a placeholder, then with the checksum of what followed it
+	ModelFileWriter writer(file);
+	bool ok = fwrite(&h, sizeof(h), 1, file) == 1;
+	writer.checksum = tldAdler32(1, (const char*) &h + checksumStart, sizeof(h) - checksumStart);
+
+	writer.seek(h.featuresOffset);
+	writer.write(features, sizeof(float)*4*h.numFeatures*h.numTrees);
+
+	writer.seek(h.truePositivesOffset);
+	for(size_t i = 0; i < truePositives.size(); i++) {
+		writer.write(truePositives[i].values, patchBytes);
+	}
+
+	writer.seek(h.falsePositivesOffset);
+	for(size_t i = 0; i < falsePositives.size(); i++) {
+		writer.write(falsePositives[i].values, patchBytes);
+	}
+
+	writer.seek(h.leavesOffset);
+	writer.write(leaves, sizeof(FernLeaf)*numLeaves(&h));
+
+	h.checksum = writer.checksum;
+	ok = ok && writer.ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, file) == 1;
+	ok = (fclose(file) == 0) && ok;
+	ok = ok && replaceFile(tempPath.c_str(), path);
+
+	if(!ok) {
+		remove(tempPath.c_str());
+		printf("Error: Unable to write model file %s\n", path);
+	}
+
+	return ok;
+}
+
+} /* namespace tld */
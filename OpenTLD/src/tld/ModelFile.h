@@ -0,0 +1,102 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * ModelFile.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef MODELFILE_H_
+#define MODELFILE_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "NormalizedPatch.h"
+
+namespace tld {
+
+struct FernLeaf;
+
+static const unsigned int TLD_MODEL_FILE_VERSION = 1;
+
+/*
+ * Binary model file. The header is followed by the sections it points to, each starting
+ * at a multiple of 64 bytes:
+ *  features: 4*numFeatures*numTrees floats, as in EnsembleClassifier::features
+ *  truePositives, falsePositives: TLD_PATCH_SIZE*TLD_PATCH_SIZE floats per patch
+ *  leaves: numTrees*2^numFeatures FernLeaf entries, as in EnsembleClassifier::leaves
+ * Everything is in the byte order of the machine that wrote the file, which byteOrder
+ * allows to check.
+ */
+struct ModelFileHeader {
+	char magic[8]; //"TLDMODEL"
+	unsigned int version;
+	unsigned int checksum; //Adler-32 of everything following this field
+	unsigned int byteOrder; //0x01020304
+	unsigned int fileSize;
+	int objWidth;
+	int objHeight;
+	float minVar;
+	int numTrees;
+	int numFeatures;
+	int patchSize;
+	int numTruePositives;
+	int numFalsePositives;
+	unsigned int featuresOffset;
+	unsigned int truePositivesOffset;
+	unsigned int falsePositivesOffset;
+	unsigned int leavesOffset;
+};
+
+/*
+ * A model file mapped into memory copy-on-write. Nothing is parsed: once the header has been
+ * checked, the sections are used where they are. Pages nobody writes to stay shared by all
+ * processes mapping the file, like the features, which never change after loading. The pages
+ * of leaves a tracker learns become private copies of that tracker; the file is not changed.
+ * The NN patches are copied, as NNClassifier keeps its own.
+ */
+class ModelFile {
+	char* data;
+	size_t size;
+	void* fileHandle; //Only used on Windows
+	void* mappingHandle;
+
+	ModelFile(const ModelFile&);
+	ModelFile& operator=(const ModelFile&);
+public:
+	ModelFile();
+	~ModelFile();
+
+	bool open(const char* path);
+	void close();
+
+	const ModelFileHeader* header() const;
+	float* features();
+	const float* truePositives() const;
+	const float* falsePositives() const;
+	FernLeaf* leaves();
+
+	static bool write(const char* path, const ModelFileHeader& description, const float* features,
+			const std::vector<NormalizedPatch>& truePositives, const std::vector<NormalizedPatch>& falsePositives,
+			const FernLeaf* leaves);
+};
+
+} /* namespace tld */
+#endif /* MODELFILE_H_ */
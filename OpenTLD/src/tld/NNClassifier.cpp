@@ -33,9 +33,22 @@ using namespace cv;
 namespace tld {
 
 NNClassifier::NNClassifier() {
+	enabled = true;
 	thetaFP = .5;
 	thetaTP = .65;
 
+	capacity = 0;
+	evictionPolicy = new LeastRecentlyMatchedEviction();
+	recordChanges = false;
+
+	iteration = 0;
+	numOfferedPositives = 0;
+	numOfferedNegatives = 0;
+	numClassified = 0;
+	numCompared = 0;
+	numEvicted = 0;
+	classificationTime = 0;
+
 	truePositives = new vector<NormalizedPatch>();
 	falsePositives = new vector<NormalizedPatch>();
 
@@ -51,52 +64,110 @@ NNClassifier::~NNClassifier() {
 void NNClassifier::release() {
 	falsePositives->clear();
 	truePositives->clear();
+	positiveModel.clear();
+	negativeModel.clear();
+	numOfferedPositives = 0;
+	numOfferedNegatives = 0;
+	clearChanges();
 }
 
-float NNClassifier::ncc(float *f1,float *f2) {
-	double corr = 0;
-	double norm1 = 0;
-	double norm2 = 0;
+//Call once per frame, before classifying its windows
+void NNClassifier::nextIteration() {
+	syncModel();
+	iteration++;
+}
 
-	int size = TLD_PATCH_SIZE*TLD_PATCH_SIZE;
+static void syncPatchMatrix(PatchMatrix& matrix, const vector<NormalizedPatch>& patches) {
+	if((int) patches.size() < matrix.size()) {
+		matrix.clear();
+	}
 
-	for (int i = 0; i<size; i++) {
-		corr += f1[i]*f2[i];
-		norm1 += f1[i]*f1[i];
-		norm2 += f2[i]*f2[i];
+	for(size_t i = matrix.size(); i < patches.size(); i++) {
+		matrix.add(patches[i].values);
 	}
-	// normalization to <0,1>
+}
 
-	return (corr / sqrt(norm1*norm2) + 1) / 2.0;
+/*
+ * Classification uses normalised copies of truePositives and falsePositives.
+ * learn() keeps them up to date; call this after adding patches to or removing patches
+ * from the vectors directly. It must not run concurrently with classification.
+ */
+void NNClassifier::syncModel() {
+	syncPatchMatrix(positiveModel, *truePositives);
+	syncPatchMatrix(negativeModel, *falsePositives);
 }
 
-float NNClassifier::classifyPatch(NormalizedPatch * patch) {
+void NNClassifier::clearChanges() {
+	changedTruePositives.clear();
+	changedFalsePositives.clear();
+}
+
+/*
+ * Makes this a copy of other, with the same settings, patches, eviction state and list of changes.
+ * other may be classifying at the same time, as long as no one changes its model or applies
+ * time stamps with touchMatches().
+ */
+void NNClassifier::copyModelFrom(const NNClassifier& other) {
+	enabled = other.enabled;
+	capacity = other.capacity;
+	//The policy may have state, like a random generator, so every classifier keeps its own. With
+	//the same state, learning the same patches evicts the same ones on both models.
+	if(evictionPolicy.empty() || &*evictionPolicy == &*other.evictionPolicy || !evictionPolicy->copyFrom(*other.evictionPolicy)) {
+		evictionPolicy = other.evictionPolicy->clone();
+	}
+	windowGrid = other.windowGrid;
+	thetaFP = other.thetaFP;
+	thetaTP = other.thetaTP;
+	detectionResult = other.detectionResult;
+
+	*truePositives = *other.truePositives;
+	*falsePositives = *other.falsePositives;
+	positiveModel.copyFrom(other.positiveModel);
+	negativeModel.copyFrom(other.negativeModel);
+	iteration = other.iteration;
+	numOfferedPositives = other.numOfferedPositives;
+	numOfferedNegatives = other.numOfferedNegatives;
+	numEvicted = other.numEvicted;
+
+	recordChanges = other.recordChanges;
+	changedTruePositives = other.changedTruePositives;
+	changedFalsePositives = other.changedFalsePositives;
+}
+
+//Takes over the classification counters of other, which has been classifying in place of this
+void NNClassifier::copyStatisticsFrom(const NNClassifier& other) {
+	numClassified = other.numClassified;
+	numCompared = other.numCompared;
+	classificationTime = other.classificationTime;
+}
+
+/*
+ * The confidence of patch. Adds to numMatched and numCompared rather than to the statistics,
+ * so that callers classifying many patches update the shared counters once.
+ * bestRows receives the closest positive and negative row, or -1 each if none was compared.
+ * Nothing is written to the model, so threads may classify concurrently.
+ */
+float NNClassifier::matchPatch(const NormalizedPatch * patch, unsigned long& numMatched, unsigned long& numComparedPatches, int * bestRows) {
+	bestRows[0] = -1;
+	bestRows[1] = -1;
 
-	if(truePositives->empty()) {
+	if(positiveModel.size() == 0) {
 		return 0;
 	}
 
-	if(falsePositives->empty()) {
+	if(negativeModel.size() == 0) {
 		return 1;
 	}
 
-	float ccorr_max_p = 0;
-	//Compare patch to positive patches
-	for(size_t i = 0; i < truePositives->size(); i++) {
-		float ccorr = ncc(truePositives->at(i).values, patch->values);
-		if(ccorr > ccorr_max_p) {
-			ccorr_max_p = ccorr;
-		}
-	}
+	float normalized[TLD_PATCH_STRIDE];
+	PatchMatrix::normalize(patch->values, normalized);
 
-	float ccorr_max_n = 0;
-	//Compare patch to positive patches
-	for(size_t i = 0; i < falsePositives->size(); i++) {
-		float ccorr = ncc(falsePositives->at(i).values, patch->values);
-		if(ccorr > ccorr_max_n) {
-			ccorr_max_n = ccorr;
-		}
-	}
+	//Correlations are mapped from [-1,1] to [0,1]
+	float ccorr_max_p = (positiveModel.maxCorrelation(normalized, &bestRows[0]) + 1) / 2;
+	float ccorr_max_n = (negativeModel.maxCorrelation(normalized, &bestRows[1]) + 1) / 2;
+
+	numMatched++;
+	numComparedPatches += positiveModel.size() + negativeModel.size();
 
 	float dN = 1-ccorr_max_n;
 	float dP = 1-ccorr_max_p;
@@ -105,6 +176,50 @@ float NNClassifier::classifyPatch(NormalizedPatch * patch) {
 	return distance;
 }
 
+//Stamps the rows matchPatch() found with the current iteration, for the eviction policy
+void NNClassifier::touchRows(const int * bestRows) {
+	if(bestRows[0] >= 0) positiveModel.touch(bestRows[0], iteration);
+	if(bestRows[1] >= 0) negativeModel.touch(bestRows[1], iteration);
+}
+
+/*
+ * Applies the rows filter() collected in matches. Must not run concurrently with classification.
+ * All stamps are the current iteration, so the order of matches does not matter.
+ */
+void NNClassifier::touchMatches(const vector<int>& matches) {
+	for(size_t i = 0; i + 1 < matches.size(); i += 2) {
+		touchRows(&matches[i]);
+	}
+}
+
+//Adds what matchPatch() counted since startTime to the statistics, which threads share
+void NNClassifier::countMatches(unsigned long numMatched, unsigned long numComparedPatches, int64 startTime) {
+	if(numMatched == 0) {
+		return;
+	}
+
+	double time = (getTickCount() - startTime) / getTickFrequency();
+	#pragma omp atomic
+	numClassified += numMatched;
+	#pragma omp atomic
+	numCompared += numComparedPatches;
+	#pragma omp atomic
+	classificationTime += time;
+}
+
+float NNClassifier::classifyPatch(NormalizedPatch * patch) {
+	int64 startTime = getTickCount();
+	unsigned long numMatched = 0;
+	unsigned long numComparedPatches = 0;
+
+	int bestRows[2];
+	float conf = matchPatch(patch, numMatched, numComparedPatches, bestRows);
+	touchRows(bestRows);
+
+	countMatches(numMatched, numComparedPatches, startTime);
+	return conf;
+}
+
 float NNClassifier::classifyBB(const Mat& img, Rect* bb) {
 	NormalizedPatch patch;
 
@@ -116,7 +231,8 @@ float NNClassifier::classifyBB(const Mat& img, Rect* bb) {
 float NNClassifier::classifyWindow(const Mat& img, int windowIdx) {
 	NormalizedPatch patch;
 
-	int * bbox = &windows[TLD_WINDOW_SIZE*windowIdx];
+	int buffer[TLD_WINDOW_SIZE];
+	int * bbox = windowGrid->window(windowIdx, buffer);
 	tldExtractNormalizedPatchBB(img, bbox, patch.values);
 
 	return classifyPatch(&patch);
@@ -134,23 +250,131 @@ bool NNClassifier::filter(const Mat& img, int windowIdx) {
 	return true;
 }
 
-void NNClassifier::learn(vector<NormalizedPatch> patches) {
+/*
+ * Batched version of filter(const Mat&, int). Removes the rejected windows from windowIndices,
+ * keeping the order of the others, and returns how many are left.
+ * Threads may run this concurrently, so the matched rows are not stamped here. If a capacity is
+ * set, which is when the eviction policy reads the stamps, they are appended to matches instead;
+ * pass them to touchMatches() once classification is done.
+ */
+int NNClassifier::filter(const Mat& img, int * windowIndices, int count, vector<int>* matches) {
+	if(!enabled) return count;
+
+	const int batchSize = 16;
+	NormalizedPatch patches[batchSize];
+
+	int64 startTime = getTickCount();
+	unsigned long numMatched = 0;
+	unsigned long numComparedPatches = 0;
+
+	int numAccepted = 0;
+	for(int start = 0; start < count; start += batchSize) {
+		int n = min(batchSize, count - start);
+		tldExtractNormalizedPatches(img, windowGrid, windowIndices + start, n, patches);
+
+		for(int k = 0; k < n; k++) {
+			int bestRows[2];
+			if(matchPatch(&patches[k], numMatched, numComparedPatches, bestRows) >= thetaTP) {
+				windowIndices[numAccepted++] = windowIndices[start + k];
+			}
+			if(capacity > 0 && matches != NULL) {
+				matches->insert(matches->end(), bestRows, bestRows + 2);
+			}
+		}
+	}
+
+	countMatches(numMatched, numComparedPatches, startTime);
+	return numAccepted;
+}
+
+void NNClassifier::learn(const vector<NormalizedPatch>& patches) {
+	if(!patches.empty()) {
+		learn(&patches[0], patches.size());
+	}
+}
+
+void NNClassifier::learn(const NormalizedPatch* patches, int numPatches) {
+	syncModel();
+
+	int64 startTime = getTickCount();
+	unsigned long numMatched = 0;
+	unsigned long numComparedPatches = 0;
+
 	//TODO: Randomization might be a good idea here
-	for(size_t i = 0; i < patches.size(); i++) {
+	for(int i = 0; i < numPatches; i++) {
 
-		NormalizedPatch patch = patches[i];
+		const NormalizedPatch& patch = patches[i];
 
-		float conf = classifyPatch(&patch);
+		int bestRows[2];
+		float conf = matchPatch(&patch, numMatched, numComparedPatches, bestRows);
+		touchRows(bestRows);
 
 		if(patch.positive && conf <= thetaTP) {
-			truePositives->push_back(patch);
+			store(patch);
 		}
 
 		if(!patch.positive && conf >= thetaFP) {
-			falsePositives->push_back(patch);
+			store(patch);
 		}
 	}
 
+	countMatches(numMatched, numComparedPatches, startTime);
+}
+
+/*
+ * Adds patch to the true or false positives. If there are capacity of them already,
+ * the eviction policy picks the patch it replaces, or discards it.
+ */
+void NNClassifier::store(const NormalizedPatch& patch) {
+	vector<NormalizedPatch>* patches = patch.positive ? truePositives : falsePositives;
+	vector<int>& changed = patch.positive ? changedTruePositives : changedFalsePositives;
+	PatchMatrix& model = patch.positive ? positiveModel : negativeModel;
+	unsigned long& numOffered = patch.positive ? numOfferedPositives : numOfferedNegatives;
+
+	//Patches loaded from a file count as offered
+	if(numOffered < (unsigned long) model.size()) {
+		numOffered = model.size();
+	}
+	numOffered++;
+
+	//Take the memory for all of them at once, so filling up to capacity does not allocate again
+	if(capacity > 0 && patches->capacity() < (size_t) capacity) {
+		patches->reserve(capacity);
+		model.reserve(capacity);
+	}
+
+	if(capacity <= 0 || model.size() < capacity) {
+		patches->push_back(patch);
+		model.add(patch.values);
+		model.touch(model.size() - 1, iteration);
+		if(recordChanges) changed.push_back(model.size() - 1);
+		return;
+	}
+
+	float normalized[TLD_PATCH_STRIDE];
+	PatchMatrix::normalize(patch.values, normalized);
+
+	int victim = evictionPolicy->selectVictim(model, normalized, numOffered);
+	if(victim < 0) {
+		return;
+	}
+
+	(*patches)[victim] = patch;
+	model.set(victim, patch.values);
+	model.touch(victim, iteration);
+	if(recordChanges) changed.push_back(victim);
+	numEvicted++;
+}
+
+NNStatistics NNClassifier::statistics() const {
+	NNStatistics s;
+	s.numTruePositives = truePositives->size();
+	s.numFalsePositives = falsePositives->size();
+	s.numClassified = numClassified;
+	s.numCompared = numCompared;
+	s.numEvicted = numEvicted;
+	s.classificationTime = classificationTime;
+	return s;
 }
 
 
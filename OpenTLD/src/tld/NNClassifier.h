@@ -30,31 +30,76 @@
 #include <opencv/cv.h>
 
 #include "NormalizedPatch.h"
+#include "PatchMatrix.h"
+#include "NNEvictionPolicy.h"
 #include "DetectionResult.h"
+#include "WindowGridCache.h"
 
 namespace tld {
 
+//Sample these over time to follow model size and classification cost
+struct NNStatistics {
+	int numTruePositives;
+	int numFalsePositives;
+	unsigned long numClassified; //Patches classified so far
+	unsigned long numCompared; //Comparisons with stored patches so far
+	unsigned long numEvicted; //Stored patches replaced so far
+	double classificationTime; //Seconds spent classifying so far, summed over all threads
+};
+
 class NNClassifier {
-	float ncc(float *f1,float *f2);
+	//Working data
+	PatchMatrix positiveModel; //Normalised copy of truePositives
+	PatchMatrix negativeModel; //Normalised copy of falsePositives
+	unsigned long iteration; //Time stamp for matched patches
+	unsigned long numOfferedPositives; //Patches learn() tried to add, for the eviction policy
+	unsigned long numOfferedNegatives;
+	unsigned long numClassified;
+	unsigned long numCompared;
+	unsigned long numEvicted;
+	double classificationTime;
+
+	void store(const NormalizedPatch& patch);
+	float matchPatch(const NormalizedPatch * patch, unsigned long& numMatched, unsigned long& numComparedPatches, int * bestRows);
+	void touchRows(const int * bestRows);
+	void countMatches(unsigned long numMatched, unsigned long numComparedPatches, int64 startTime);
 public:
 	bool enabled;
 
-	int * windows;
+	//Configurable members
+	int capacity; //Maximum number of stored patches per class. 0 means unlimited.
+	cv::Ptr<NNEvictionPolicy> evictionPolicy; //Decides which patch to replace once capacity is reached. Not shared with other classifiers.
+
+	WindowGrid* windowGrid;
 	float thetaFP;
 	float thetaTP;
 	DetectionResult* detectionResult;
 	std::vector<NormalizedPatch>* falsePositives;
 	std::vector<NormalizedPatch>* truePositives;
 
+	//Checkpointing
+	bool recordChanges; //Lets learn() list the rows it stores patches in
+	std::vector<int> changedTruePositives; //Rows of truePositives changed since the last clearChanges(), may repeat
+	std::vector<int> changedFalsePositives;
+
 	NNClassifier();
 	virtual ~NNClassifier();
 
 	void release();
+	void nextIteration();
+	void syncModel();
+	void clearChanges();
+	void copyModelFrom(const NNClassifier& other);
+	void copyStatisticsFrom(const NNClassifier& other);
 	float classifyPatch(NormalizedPatch * patch);
 	float classifyBB(const cv::Mat& img, cv::Rect* bb);
 	float classifyWindow(const cv::Mat& img, int windowIdx);
-	void learn(std::vector<NormalizedPatch> patches);
+	void learn(const std::vector<NormalizedPatch>& patches);
+	void learn(const NormalizedPatch* patches, int numPatches);
 	bool filter(const cv::Mat& img, int windowIdx);
+	int filter(const cv::Mat& img, int * windowIndices, int count, std::vector<int>* matches);
+	void touchMatches(const std::vector<int>& matches);
+	NNStatistics statistics() const;
 };
 
 } /* namespace tld */
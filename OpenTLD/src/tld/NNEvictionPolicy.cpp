@@ -0,0 +1,82 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * NNEvictionPolicy.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "NNEvictionPolicy.h"
+
+namespace tld {
+
+int LeastRecentlyMatchedEviction::selectVictim(const PatchMatrix& model, const float* normalized, unsigned long numOffered) {
+	int victim = -1;
+	for(int i = 0; i < model.size(); i++) {
+		if(victim == -1 || model.lastMatch(i) < model.lastMatch(victim)) {
+			victim = i;
+		}
+	}
+	return victim;
+}
+
+NNEvictionPolicy* LeastRecentlyMatchedEviction::clone() const {
+	return new LeastRecentlyMatchedEviction(*this);
+}
+
+bool LeastRecentlyMatchedEviction::copyFrom(const NNEvictionPolicy& other) {
+	return dynamic_cast<const LeastRecentlyMatchedEviction*>(&other) != NULL;
+}
+
+ReservoirEviction::ReservoirEviction(uint64 seed) : rng(seed) {
+}
+
+int ReservoirEviction::selectVictim(const PatchMatrix& model, const float* normalized, unsigned long numOffered) {
+	unsigned long j = (unsigned long) rng.next() % numOffered;
+	return (j < (unsigned long) model.size()) ? (int) j : -1;
+}
+
+NNEvictionPolicy* ReservoirEviction::clone() const {
+	return new ReservoirEviction(*this);
+}
+
+bool ReservoirEviction::copyFrom(const NNEvictionPolicy& other) {
+	const ReservoirEviction* reservoir = dynamic_cast<const ReservoirEviction*>(&other);
+	if(reservoir == NULL) {
+		return false;
+	}
+	rng = reservoir->rng;
+	return true;
+}
+
+int RedundancyEviction::selectVictim(const PatchMatrix& model, const float* normalized, unsigned long numOffered) {
+	int victim;
+	model.maxCorrelation(normalized, &victim);
+	return victim;
+}
+
+NNEvictionPolicy* RedundancyEviction::clone() const {
+	return new RedundancyEviction(*this);
+}
+
+bool RedundancyEviction::copyFrom(const NNEvictionPolicy& other) {
+	return dynamic_cast<const RedundancyEviction*>(&other) != NULL;
+}
+
+} /* namespace tld */
@@ -0,0 +1,82 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * NNEvictionPolicy.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef NNEVICTIONPOLICY_H_
+#define NNEVICTIONPOLICY_H_
+
+#include <opencv/cv.h>
+
+#include "PatchMatrix.h"
+
+namespace tld {
+
+/*
+ * Decides which stored patch makes room for a new one once the NN classifier
+ * holds as many patches of a class as its capacity allows.
+ */
+class NNEvictionPolicy {
+public:
+	virtual ~NNEvictionPolicy() {}
+
+	//Returns the row of model to replace by the new patch, or -1 to discard the new patch.
+	//numOffered counts the patches offered to model so far, including the new one.
+	virtual int selectVictim(const PatchMatrix& model, const float* normalized, unsigned long numOffered) = 0;
+
+	//Returns a new policy with the same settings and state as this one
+	virtual NNEvictionPolicy* clone() const = 0;
+
+	//Takes over the state of other. Returns false if other is a different kind of policy.
+	virtual bool copyFrom(const NNEvictionPolicy& other) = 0;
+};
+
+//Replaces the patch that has gone unmatched the longest
+class LeastRecentlyMatchedEviction : public NNEvictionPolicy {
+public:
+	int selectVictim(const PatchMatrix& model, const float* normalized, unsigned long numOffered);
+	NNEvictionPolicy* clone() const;
+	bool copyFrom(const NNEvictionPolicy& other);
+};
+
+//Keeps a uniform random sample of all patches offered so far. Draws from its own generator,
+//so the sample does not depend on other trackers or on how threads are scheduled.
+class ReservoirEviction : public NNEvictionPolicy {
+	cv::RNG rng;
+public:
+	ReservoirEviction(uint64 seed = 1);
+
+	int selectVictim(const PatchMatrix& model, const float* normalized, unsigned long numOffered);
+	NNEvictionPolicy* clone() const;
+	bool copyFrom(const NNEvictionPolicy& other);
+};
+
+//Replaces the stored patch most similar to the new one, which makes it redundant
+class RedundancyEviction : public NNEvictionPolicy {
+public:
+	int selectVictim(const PatchMatrix& model, const float* normalized, unsigned long numOffered);
+	NNEvictionPolicy* clone() const;
+	bool copyFrom(const NNEvictionPolicy& other);
+};
+
+} /* namespace tld */
+#endif /* NNEVICTIONPOLICY_H_ */
@@ -0,0 +1,218 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * PatchMatrix.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "PatchMatrix.h"
+
+#include <cmath>
+#include <cstring>
+#include <opencv/cv.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TLD_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace tld {
+
+PatchMatrix::PatchMatrix() {
+	data = NULL;
+	lastMatches = NULL;
+	numRows = 0;
+	capacity = 0;
+}
+
+PatchMatrix::~PatchMatrix() {
+	cv::fastFree(data);
+	delete[] lastMatches;
+}
+
+int PatchMatrix::size() const {
+	return numRows;
+}
+
+const float* PatchMatrix::row(int i) const {
+	return data + TLD_PATCH_STRIDE*i;
+}
+
+//cv::fastMalloc returns 16 byte aligned memory
+void PatchMatrix::reserve(int rows) {
+	if(rows <= capacity) {
+		return;
+	}
+
+	int newCapacity = (capacity > 0) ? capacity : 16;
+	while(newCapacity < rows) {
+		newCapacity *= 2;
+	}
+
+	float* newData = (float*) cv::fastMalloc(sizeof(float)*TLD_PATCH_STRIDE*newCapacity);
+	unsigned long* newLastMatches = new unsigned long[newCapacity];
+	if(data != NULL) {
+		memcpy(newData, data, sizeof(float)*TLD_PATCH_STRIDE*numRows);
+		memcpy(newLastMatches, lastMatches, sizeof(unsigned long)*numRows);
+		cv::fastFree(data);
+		delete[] lastMatches;
+	}
+	data = newData;
+	lastMatches = newLastMatches;
+	capacity = newCapacity;
+}
+
+void PatchMatrix::add(const float* values) {
+	reserve(numRows + 1);
+	numRows++;
+	set(numRows - 1, values);
+	lastMatches[numRows - 1] = 0;
+}
+
+void PatchMatrix::set(int i, const float* values) {
+	normalize(values, data + TLD_PATCH_STRIDE*i);
+}
+
+void PatchMatrix::clear() {
+	numRows = 0;
+}
+
+//Keeps the memory this already has if it is large enough
+void PatchMatrix::copyFrom(const PatchMatrix& other) {
+	reserve(other.numRows);
+	if(other.numRows > 0) {
+		memcpy(data, other.data, sizeof(float)*TLD_PATCH_STRIDE*other.numRows);
+		memcpy(lastMatches, other.lastMatches, sizeof(unsigned long)*other.numRows);
+	}
+	numRows = other.numRows;
+}
+
+unsigned long PatchMatrix::lastMatch(int i) const {
+	return lastMatches[i];
+}
+
+void PatchMatrix::touch(int i, unsigned long time) {
+	lastMatches[i] = time;
+}
+
+/*
+ * Returns the largest dot product of normalized, as created by normalize(), with any row.
+ * This is the correlation coefficient in [-1,1]; -1 if the matrix is empty.
+ * If bestRow is given, it receives the first row with that product, or -1.
+ * Four rows are processed at once, sharing the loads of normalized.
+ */
+float PatchMatrix::maxCorrelation(const float* normalized, int* bestRow) const {
+	float best = -1;
+	int bestIndex = -1;
+	int i = 0;
+
+#ifdef TLD_USE_SSE2
+	__m128 bestDots = _mm_set1_ps(-2); //Below any correlation, so every lane gets a row
+	__m128i bestIndices = _mm_set1_epi32(-1);
+
+	for(; i + 4 <= numRows; i += 4) {
+		const float* r0 = data + TLD_PATCH_STRIDE*i;
+		const float* r1 = r0 + TLD_PATCH_STRIDE;
+		const float* r2 = r1 + TLD_PATCH_STRIDE;
+		const float* r3 = r2 + TLD_PATCH_STRIDE;
+
+		__m128 s0 = _mm_setzero_ps();
+		__m128 s1 = _mm_setzero_ps();
+		__m128 s2 = _mm_setzero_ps();
+		__m128 s3 = _mm_setzero_ps();
+
+		for(int k = 0; k < TLD_PATCH_STRIDE; k += 4) {
+			__m128 p = _mm_loadu_ps(normalized + k);
+			s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_load_ps(r0 + k), p));
+			s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_load_ps(r1 + k), p));
+			s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_load_ps(r2 + k), p));
+			s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_load_ps(r3 + k), p));
+		}
+
+		//Afterwards, lane j of the sum holds the dot product with row i+j
+		_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+		__m128 dots = _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3));
+
+		__m128i better = _mm_castps_si128(_mm_cmpgt_ps(dots, bestDots));
+		__m128i indices = _mm_set_epi32(i+3, i+2, i+1, i);
+		bestIndices = _mm_or_si128(_mm_and_si128(better, indices), _mm_andnot_si128(better, bestIndices));
+		bestDots = _mm_max_ps(bestDots, dots);
+	}
+
+	float dots[4];
+	int indices[4];
+	_mm_storeu_ps(dots, bestDots);
+	_mm_storeu_si128((__m128i*)indices, bestIndices);
+	for(int j = 0; j < 4; j++) {
+		if(indices[j] >= 0 && (bestIndex == -1 || dots[j] > best || (dots[j] == best && indices[j] < bestIndex))) {
+			best = dots[j];
+			bestIndex = indices[j];
+		}
+	}
+#endif
+
+	for(; i < numRows; i++) {
+		const float* r = data + TLD_PATCH_STRIDE*i;
+		float dot = 0;
+		for(int k = 0; k < TLD_PATCH_STRIDE; k++) {
+			dot += r[k]*normalized[k];
+		}
+		if(dot > best || bestIndex == -1) {
+			best = dot;
+			bestIndex = i;
+		}
+	}
+
+	if(bestRow != NULL) {
+		*bestRow = bestIndex;
+	}
+	return best;
+}
+
+/*
+ * Writes TLD_PATCH_STRIDE floats: values minus their mean, divided by their norm, padded with zeros.
+ * A constant patch becomes all zeros.
+ */
+void PatchMatrix::normalize(const float* values, float* output) {
+	const int size = TLD_PATCH_SIZE*TLD_PATCH_SIZE;
+
+	double mean = 0;
+	for(int k = 0; k < size; k++) {
+		mean += values[k];
+	}
+	mean /= size;
+
+	double norm = 0;
+	for(int k = 0; k < size; k++) {
+		double v = values[k] - mean;
+		norm += v*v;
+	}
+	norm = sqrt(norm);
+
+	float scale = (norm > 0) ? (float) (1/norm) : 0;
+	for(int k = 0; k < size; k++) {
+		output[k] = (float) (values[k] - mean) * scale;
+	}
+	for(int k = size; k < TLD_PATCH_STRIDE; k++) {
+		output[k] = 0;
+	}
+}
+
+} /* namespace tld */
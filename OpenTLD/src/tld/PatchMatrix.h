@@ -0,0 +1,76 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * PatchMatrix.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef PATCHMATRIX_H_
+#define PATCHMATRIX_H_
+
+#include <cstddef>
+
+#include "NormalizedPatch.h"
+
+namespace tld {
+
+//Patch length rounded up to a multiple of four floats, so that every row is 16 byte aligned
+static const int TLD_PATCH_STRIDE = (TLD_PATCH_SIZE*TLD_PATCH_SIZE + 3) & ~3;
+
+/*
+ * Patches stored zero-mean and with unit norm, one per row of a contiguous,
+ * aligned matrix. The normalised cross-correlation of two such patches is
+ * their dot product, so comparing a patch to all rows is a single pass over
+ * the matrix.
+ * Each row also has a time stamp of when it last matched a patch, for which
+ * the caller chooses the unit.
+ */
+class PatchMatrix {
+	float* data;
+	unsigned long* lastMatches;
+	int numRows;
+	int capacity;
+
+	PatchMatrix(const PatchMatrix&);
+	PatchMatrix& operator=(const PatchMatrix&);
+public:
+	PatchMatrix();
+	~PatchMatrix();
+
+	int size() const;
+	const float* row(int i) const;
+
+	void reserve(int rows);
+
+	void add(const float* values);
+	void set(int i, const float* values);
+	void clear();
+	void copyFrom(const PatchMatrix& other);
+
+	unsigned long lastMatch(int i) const;
+	void touch(int i, unsigned long time);
+
+	float maxCorrelation(const float* normalized, int* bestRow = NULL) const;
+
+	static void normalize(const float* values, float* output);
+};
+
+} /* namespace tld */
+#endif /* PATCHMATRIX_H_ */
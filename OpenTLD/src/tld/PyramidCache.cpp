@@ -0,0 +1,53 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * PyramidCache.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "PyramidCache.h"
+#include "fbtrack.h"
+
+using namespace cv;
+
+namespace tld {
+
+LKPyramid::LKPyramid() {
+	pyr = NULL;
+}
+
+LKPyramid::~LKPyramid() {
+	cvReleaseImage(&pyr);
+}
+
+void LKPyramid::build(const Mat& img) {
+	CvSize pyrSize = cvSize(img.cols + 8, img.rows / 3);
+	if(pyr != NULL && (pyr->width != pyrSize.width || pyr->height != pyrSize.height)) {
+		cvReleaseImage(&pyr);
+	}
+	if(pyr == NULL) {
+		pyr = cvCreateImage(pyrSize, IPL_DEPTH_32F, 1);
+	}
+
+	IplImage iplImg = img;
+	buildPyramidLK(&iplImg, pyr, FBTRACK_LEVEL);
+}
+
+} /* namespace tld */
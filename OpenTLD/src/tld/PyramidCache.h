@@ -0,0 +1,58 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * PyramidCache.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef PYRAMIDCACHE_H_
+#define PYRAMIDCACHE_H_
+
+#include <opencv/cv.h>
+
+#include "FrameCache.h"
+
+namespace tld {
+
+//The pyramid of a frame as cvCalcOpticalFlowPyrLK uses it, for FBTRACK_LEVEL
+class LKPyramid {
+	LKPyramid(const LKPyramid&);
+	LKPyramid& operator=(const LKPyramid&);
+public:
+	IplImage* pyr;
+
+	LKPyramid();
+	~LKPyramid();
+	void build(const cv::Mat& img);
+};
+
+/*
+ * Keeps the LK pyramids of the most recent frames, so that each frame's
+ * pyramid is built once: as the current frame of one call to track and
+ * then as the previous frame of the next one. Trackers working on the
+ * same frames may share a cache, and then share the pyramids as well.
+ */
+class PyramidCache : public FrameCache<LKPyramid> {
+public:
+	PyramidCache() : FrameCache<LKPyramid>(2) {} //The previous and the current frame
+};
+
+} /* namespace tld */
+#endif /* PYRAMIDCACHE_H_ */
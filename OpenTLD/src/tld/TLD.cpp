@@ -26,6 +26,8 @@
 #include "TLD.h"
 #include "NNClassifier.h"
 #include "TLDUtil.h"
+#include "ModelFile.h"
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -38,6 +40,19 @@ TLD::TLD() {
 	detectorEnabled = true;
 	learningEnabled = true;
 	alternating = false;
+	restrictSearch = false;
+	searchMargin = 1;
+	searchGrowth = 1.5;
+	pipelined = false;
+	learnPending = false;
+	asyncLearning = false;
+	learningModelValid = false;
+	frameDone = false;
+	learningEnsemble = NULL;
+	learningNNClassifier = NULL;
+	hasLastKnownBB = false;
+	framesLost = 0;
+	prevFrameId = currFrameId = 0;
 	valid = false;
 	wasValid = false;
 	learning = false;
@@ -55,29 +70,55 @@ TLD::~TLD() {
 
 	delete detectorCascade;
 	delete medianFlowTracker;
+	delete learningEnsemble;
+	delete learningNNClassifier;
 }
 
 void TLD::release() {
 	detectorCascade->release();
 	medianFlowTracker->cleanPreviousData();
-	delete currBB;
+	currBB = NULL;
+	checkpointPath.clear();
+	hasLastKnownBB = false;
+	learnPending = false;
+	learningQueue.clear();
+	discardLearningModel();
+	if(learningEnsemble != NULL) {
+		learningEnsemble->release();
+		learningNNClassifier->release();
+	}
 }
 
 void TLD::storeCurrentData() {
 	prevImg.release();
 	prevImg = currImg; //Store old image (if any)
-	delete prevBB;
-	prevBB = currBB;		//Store old bounding box (if any)
+	prevFrameId = currFrameId;
+	prevBB = NULL;
+	if(currBB != NULL) {
+		prevBBStorage = *currBB; //Store old bounding box (if any)
+		prevBB = &prevBBStorage;
+	}
 
-	detectorCascade->cleanPreviousData(); //Reset detector results
+	if(!learnPending) { //Otherwise learning still needs them
+		detectorCascade->cleanPreviousData(); //Reset detector results
+	}
 	medianFlowTracker->cleanPreviousData();
 
 	wasValid = valid;
 }
 
-void TLD::selectObject(const Mat& img, Rect * bb) {
+/*
+ * frameId identifies img in the caches of the tracker and the detector. Callers sharing caches
+ * between TLD instances give every frame an id from tldNewFrameId() and pass it to all of them;
+ * 0 draws a new one.
+ */
+void TLD::selectObject(const Mat& img, Rect * bb, unsigned long frameId) {
 	//Delete old object
 	detectorCascade->release();
+	checkpointPath.clear();
+	learnPending = false;
+	learningQueue.clear();
+	discardLearningModel();
 
 	detectorCascade->objWidth = bb->width;
 	detectorCascade->objHeight = bb->height;
@@ -86,35 +127,206 @@ void TLD::selectObject(const Mat& img, Rect * bb) {
 	detectorCascade->init();
 
 	currImg = img;
-	currBB = tldCopyRect(bb);
+	currFrameId = (frameId != 0) ? frameId : tldNewFrameId();
+	currBBStorage = *bb;
+	currBB = &currBBStorage;
 	currConf = 1;
 	valid = true;
 
+	lastKnownBB = *bb;
+	hasLastKnownBB = true;
+	framesLost = 0;
+
 	initialLearning();
 
 }
 
-void TLD::processImage(const Mat& img, bool isGray) {
-	storeCurrentData();
+//frameId identifies img like in selectObject()
+void TLD::processImage(const Mat& img, bool isGray, unsigned long frameId) {
 	Mat grey_frame;
-	if(isGray)	
-		grey_frame = img;
-	else
+	if(isGray)	
+		grey_frame = img;
+	else
 		cvtColor( img,grey_frame, CV_RGB2GRAY );
+
+	if(frameId == 0) {
+		frameId = tldNewFrameId();
+	}
+
+	if(asyncLearning) {
+		prepareLearningModel();
+		frameDone = false;
+
+		//Learning from earlier frames goes on next to this one
+		#pragma omp parallel sections num_threads(2)
+		{
+			#pragma omp section
+			{
+				processFrame(grey_frame, frameId);
+				frameDone = true;
+				#pragma omp flush(frameDone)
+			}
+
+			#pragma omp section
+			learnInBackground();
+		}
+
+		publishLearnedModel();
+	} else {
+		learnQueuedJobs(); //Left over if asyncLearning was just switched off
+		processFrame(grey_frame, frameId);
+	}
+}
+
+void TLD::processFrame(const Mat& grey_frame, unsigned long frameId) {
+	if(pipelined) {
+		processImagePipelined(grey_frame, frameId);
+		return;
+	}
+
+	runPendingLearn(); //Left over if pipelined was just switched off
+
+	trackFrame(grey_frame, frameId);
+
+	if(wantsDetection()) {
+		detect(grey_frame, frameId);
+	}
+
+	fuseHypotheses();
+
+	learn(asyncLearning);
+}
+
+/*
+ * processImage() in steps, for callers that run the detectors of several objects together, see
+ * DetectorCascade::detectTogether(): trackFrame(), the detector if wantsDetection(), fuseAndLearn().
+ * The steps learn from each frame right away and leave the scan to the caller, so pipelined,
+ * asyncLearning and restrictSearch do not apply. Call finishLearning() before trackFrame() in
+ * case processImage() left learning behind in one of those modes.
+ */
+void TLD::trackFrame(const Mat& grey_frame, unsigned long frameId) {
+	storeCurrentData();
 	currImg = grey_frame; // Store new image , right after storeCurrentData();
+	currFrameId = frameId;
 
-	if(trackerEnabled) {
-		medianFlowTracker->track(prevImg, currImg, prevBB);
+	//There is no previous image right after readCheckpoint()
+	if(trackerEnabled && !prevImg.empty()) {
+		medianFlowTracker->track(prevImg, prevFrameId, currImg, currFrameId, prevBB);
 	}
+}
 
-	if(detectorEnabled && (!alternating || medianFlowTracker->trackerBB == NULL)) {
-		detectorCascade->detect(grey_frame);
+bool TLD::wantsDetection() const {
+	return detectorEnabled && (!alternating || medianFlowTracker->trackerBB == NULL);
+}
+
+void TLD::fuseAndLearn() {
+	fuseHypotheses();
+
+	learn(false);
+}
+
+/*
+ * The tracker and the detector only read the frames, so they run in two sections at the same
+ * time. Learning from a frame changes the detector, though, so it is put off until the next
+ * frame, where it runs in the detector's section before detection while the tracker is busy.
+ * The detector then works on the same model as without pipelining. Only restrictSearch has to
+ * do without the tracker's box.
+ * The detector's own threads need nested parallelism (omp_set_nested) to run in a section.
+ */
+void TLD::processImagePipelined(const Mat& grey_frame, unsigned long frameId) {
+	storeCurrentData(); //Keeps currImg, currBB and the detection result for learning
+
+	#pragma omp parallel sections num_threads(2) if(!alternating)
+	{
+		#pragma omp section
+		{
+			if(trackerEnabled && !prevImg.empty()) {
+				medianFlowTracker->track(prevImg, prevFrameId, grey_frame, frameId, prevBB);
+			}
+		}
+
+		//Without a second thread, sections run in order, so alternating can look at the tracker's box
+		#pragma omp section
+		{
+			runPendingLearn();
+			detectorCascade->cleanPreviousData();
+
+			if(wantsDetection()) {
+				detect(grey_frame, frameId);
+			}
+		}
 	}
 
+	currImg = grey_frame;
+	currFrameId = frameId;
+
 	fuseHypotheses();
 
-	learn();
+	learnPending = true;
+}
+
+void TLD::runPendingLearn() {
+	if(!learnPending) {
+		return;
+	}
+	learnPending = false;
 
+	learn(asyncLearning);
+}
+
+//Learns what processImage() put off in pipelined mode or queued for asyncLearning. Call it before looking at the model.
+void TLD::finishLearning() {
+	runPendingLearn();
+	learnQueuedJobs();
+}
+
+/*
+ * With restrictSearch, the detector scans a region around where the object was last valid and
+ * where the tracker has it now. The region grows with every frame the object stays lost. Once
+ * it covers the whole frame, a lost object is searched for like without restrictSearch.
+ * A lost object may be anywhere, so the detector scans the frame with detectSliced(), which
+ * spreads the scan over several frames if DetectorCascade::numScanSlices or scanTimeBudget is set.
+ */
+void TLD::detect(const Mat& img, unsigned long frameId) {
+	if(!restrictSearch) {
+		if(wasValid) {
+			detectorCascade->detect(img, frameId);
+		} else {
+			detectorCascade->detectSliced(img, frameId);
+		}
+		return;
+	}
+
+	if(wasValid && prevBB != NULL) {
+		lastKnownBB = *prevBB;
+		hasLastKnownBB = true;
+		framesLost = 0;
+	} else {
+		framesLost++;
+	}
+
+	if(hasLastKnownBB) {
+		Rect center = lastKnownBB;
+		if(!pipelined && medianFlowTracker->trackerBB != NULL) { //Still being tracked if pipelined
+			center = center | *medianFlowTracker->trackerBB;
+		}
+
+		float margin = searchMargin * pow(searchGrowth, (float) min(framesLost, 100));
+		int dx = (int) min(margin * center.width, (float) img.cols);
+		int dy = (int) min(margin * center.height, (float) img.rows);
+		Rect region(center.x - dx, center.y - dy, center.width + 2*dx, center.height + 2*dy);
+
+		if(region.x > 0 || region.y > 0 || region.x + region.width < img.cols || region.y + region.height < img.rows) {
+			detectorCascade->detect(img, frameId, &region);
+			return;
+		}
+	}
+
+	if(framesLost == 0) {
+		detectorCascade->detect(img, frameId);
+	} else {
+		detectorCascade->detectSliced(img, frameId);
+	}
 }
 
 void TLD::fuseHypotheses() {
@@ -138,10 +350,12 @@ void TLD::fuseHypotheses() {
 
 		if(numClusters == 1 && confDetector > confTracker && tldOverlapRectRect(*trackerBB, *detectorBB) < 0.5) {
 
-			currBB = tldCopyRect(detectorBB);
+			currBBStorage = *detectorBB;
+			currBB = &currBBStorage;
 			currConf = confDetector;
 		} else {
-			currBB = tldCopyRect(trackerBB);
+			currBBStorage = *trackerBB;
+			currBB = &currBBStorage;
 			currConf = confTracker;
 			if(confTracker > nnClassifier->thetaTP) {
 				valid = true;
@@ -150,7 +364,8 @@ void TLD::fuseHypotheses() {
 			}
 		}
 	} else if(numClusters == 1) {
-		currBB = tldCopyRect(detectorBB);
+		currBBStorage = *detectorBB;
+		currBB = &currBBStorage;
 		currConf = confDetector;
 	}
 
@@ -166,9 +381,11 @@ void TLD::fuseHypotheses() {
 void TLD::initialLearning() {
 	learning = true; //This is just for display purposes
 
+	discardLearningModel();
+
 	DetectionResult* detectionResult = detectorCascade->detectionResult;
 
-	detectorCascade->detect(currImg);
+	detectorCascade->detect(currImg, currFrameId);
 
 	//This is the positive patch
 	NormalizedPatch patch;
@@ -179,67 +396,67 @@ void TLD::initialLearning() {
 	detectorCascade->varianceFilter->minVar = initVar/2;
 
 
-	float * overlap = new float[detectorCascade->numWindows];
-	tldOverlapRect(detectorCascade->windows, detectorCascade->numWindows, currBB,overlap);
+	WorkingSet* workingSet = detectorCascade->workingSet;
+	int numWindows = detectorCascade->numWindows;
+
+	float * overlap = workingSet->alloc<float>(numWindows);
+	tldOverlapRect(detectorCascade->windowGrid, currBB,overlap);
 
 	//Add all bounding boxes with high overlap
 
-	vector< pair<int,float> > positiveIndices;
-	vector<int> negativeIndices;
+	pair<int,float>* positiveIndices = workingSet->alloc<pair<int,float> >(numWindows);
+	int numPositiveIndices = 0;
+	int* negativeIndices = workingSet->alloc<int>(numWindows);
+	int numNegativeIndices = 0;
 
 	//First: Find overlapping positive and negative patches
 
-	for(int i = 0; i < detectorCascade->numWindows; i++) {
+	for(int i = 0; i < numWindows; i++) {
 
 		if(overlap[i] > 0.6) {
-			positiveIndices.push_back(pair<int,float>(i,overlap[i]));
+			positiveIndices[numPositiveIndices++] = pair<int,float>(i,overlap[i]);
 		}
 
 		if(overlap[i] < 0.2) {
 			float variance = detectionResult->variances[i];
 
 			if(!detectorCascade->varianceFilter->enabled || variance > detectorCascade->varianceFilter->minVar) { //TODO: This check is unnecessary if minVar would be set before calling detect.
-				negativeIndices.push_back(i);
+				negativeIndices[numNegativeIndices++] = i;
 			}
 		}
 	}
 
-	sort(positiveIndices.begin(), positiveIndices.end(), tldSortByOverlapDesc);
+	sort(positiveIndices, positiveIndices + numPositiveIndices, tldSortByOverlapDesc);
 
-	vector<NormalizedPatch> patches;
+	int numNegativePatches = std::min(100, numNegativeIndices); //Choose 100 random patches for negative examples
+	NormalizedPatch* patches = workingSet->alloc<NormalizedPatch>(1 + numNegativePatches);
+	int numPatches = 0;
 
-	patches.push_back(patch); //Add first patch to patch list
+	patches[numPatches++] = patch; //Add first patch to patch list
 
-	int numIterations = std::min<size_t>(positiveIndices.size(), 10); //Take at most 10 bounding boxes (sorted by overlap)
+	int numIterations = std::min(numPositiveIndices, 10); //Take at most 10 bounding boxes (sorted by overlap)
 	for(int i = 0; i < numIterations; i++) {
-		int idx = positiveIndices.at(i).first;
+		int idx = positiveIndices[i].first;
 		//Learn this bounding box
 		//TODO: Somewhere here image warping might be possible
-		detectorCascade->ensembleClassifier->learn(&detectorCascade->windows[TLD_WINDOW_SIZE*idx], true, &detectionResult->featureVectors[detectorCascade->numTrees*idx]);
+		detectorCascade->ensembleClassifier->learn(idx, true, &detectionResult->featureVectors[detectorCascade->numTrees*idx]);
 	}
 
 	srand(1); //TODO: This is not guaranteed to affect random_shuffle
 
-	random_shuffle(negativeIndices.begin(), negativeIndices.end());
-
-	//Choose 100 random patches for negative examples
-	for(size_t i = 0; i < std::min<size_t>(100,negativeIndices.size()); i++) {
-		int idx = negativeIndices.at(i);
+	random_shuffle(negativeIndices, negativeIndices + numNegativeIndices);
 
-		NormalizedPatch patch;
-		tldExtractNormalizedPatchBB(currImg, &detectorCascade->windows[TLD_WINDOW_SIZE*idx], patch.values);
-		patch.positive = 0;
-		patches.push_back(patch);
+	tldExtractNormalizedPatches(currImg, detectorCascade->windowGrid, negativeIndices, numNegativePatches, patches + numPatches);
+	for(int i = 0; i < numNegativePatches; i++) {
+		patches[numPatches++].positive = 0;
 	}
 
-	detectorCascade->nnClassifier->learn(patches);
-
-	delete[] overlap;
+	detectorCascade->nnClassifier->learn(patches, numPatches);
 
 }
 
-//Do this when current trajectory is valid
-void TLD::learn() {
+//Do this when current trajectory is valid. With queue, the learning is left to learnInBackground().
+void TLD::learn(bool queue) {
 	if(!learningEnabled || !valid || !detectorEnabled) {
 		learning = false;
 		return;
@@ -249,80 +466,245 @@ void TLD::learn() {
 	DetectionResult* detectionResult = detectorCascade->detectionResult;
 
 	if(!detectionResult->containsValidData) {
-		detectorCascade->detect(currImg);
+		detectorCascade->detect(currImg, currFrameId);
 	}
 
-	//This is the positive patch
-	NormalizedPatch patch;
-	tldExtractNormalizedPatchRect(currImg, currBB, patch.values);
+	WorkingSet* workingSet = detectorCascade->workingSet;
+	int numWindows = detectorCascade->numWindows;
+	int numTrees = detectorCascade->numTrees;
 
-	float * overlap = new float[detectorCascade->numWindows];
-	tldOverlapRect(detectorCascade->windows, detectorCascade->numWindows, currBB,overlap);
+	float * overlap = workingSet->alloc<float>(numWindows);
+	tldOverlapRect(detectorCascade->windowGrid, currBB,overlap);
 
 	//Add all bounding boxes with high overlap
 
-	vector<pair<int,float> > positiveIndices;
-	vector<int> negativeIndices;
-	vector<int> negativeIndicesForNN;
+	pair<int,float>* positiveIndices = workingSet->alloc<pair<int,float> >(numWindows);
+	int numPositiveIndices = 0;
+	int* negativeIndices = workingSet->alloc<int>(numWindows);
+	int numNegativeIndices = 0;
+	int* negativeIndicesForNN = workingSet->alloc<int>(numWindows);
+	int numNegativeIndicesForNN = 0;
+
+	EnsembleClassifier* ensemble = detectorCascade->ensembleClassifier;
+	ensemble->nextIteration(currImg); //Features skipped by earlyExit are calculated from the frame
 
 	//First: Find overlapping positive and negative patches
 
-	for(int i = 0; i < detectorCascade->numWindows; i++) {
+	for(int i = 0; i < numWindows; i++) {
+		if(!detectorCascade->isFresh(i)) {
+			continue; //Left over from an earlier frame by detectSliced()
+		}
 
 		if(overlap[i] > 0.6) {
-			positiveIndices.push_back(pair<int,float>(i,overlap[i]));
+			positiveIndices[numPositiveIndices++] = pair<int,float>(i,overlap[i]);
 		}
 
 		if(overlap[i] < 0.2) {
-			if(!detectorCascade->ensembleClassifier->enabled || detectionResult->posteriors[i] > 0.1) { //TODO: Shouldn't this read as 0.5?
-				negativeIndices.push_back(i);
+			float posterior = ensemble->enabled ? ensemble->completePosterior(i, 0.1f) : 0; //Exact where earlyExit matters
+
+			if(!ensemble->enabled || posterior > 0.1) { //TODO: Shouldn't this read as 0.5?
+				negativeIndices[numNegativeIndices++] = i;
 			}
 
-			if(!detectorCascade->ensembleClassifier->enabled || detectionResult->posteriors[i] > 0.5) {
-				negativeIndicesForNN.push_back(i);
+			if(!ensemble->enabled || posterior > 0.5) {
+				negativeIndicesForNN[numNegativeIndicesForNN++] = i;
 			}
 
 		}
 	}
 
-	sort(positiveIndices.begin(), positiveIndices.end(), tldSortByOverlapDesc);
+	sort(positiveIndices, positiveIndices + numPositiveIndices, tldSortByOverlapDesc);
 
-	vector<NormalizedPatch> patches;
+	int numIterations = std::min(numPositiveIndices, 10); //Take at most 10 bounding boxes (sorted by overlap)
 
-	patch.positive = 1;
-	patches.push_back(patch);
-	//TODO: Flip
+	if(!queue) {
+		discardLearningModel();
+
+		for(int i = 0; i < numNegativeIndices; i++) {
+			int idx = negativeIndices[i];
+			//TODO: Somewhere here image warping might be possible
+			ensemble->learn(idx, false, &detectionResult->featureVectors[numTrees*idx]);
+		}
+
+		//TODO: Randomization might be a good idea
+		for(int i = 0; i < numIterations; i++) {
+			int idx = positiveIndices[i].first;
+			//TODO: Somewhere here image warping might be possible
+			ensemble->learn(idx, true, &detectionResult->featureVectors[numTrees*idx]);
+		}
 
+		NormalizedPatch* patches = workingSet->alloc<NormalizedPatch>(1 + numNegativeIndicesForNN);
+		learnPatches(currImg, *currBB, negativeIndicesForNN, numNegativeIndicesForNN, detectorCascade->nnClassifier, patches);
+		return;
+	}
+
+	LearningJob* job = learningQueue.newJob();
+	job->img = currImg;
+	job->bb = *currBB;
+	job->negativeIndices.assign(negativeIndices, negativeIndices + numNegativeIndices);
+	job->negativeIndicesForNN.assign(negativeIndicesForNN, negativeIndicesForNN + numNegativeIndicesForNN);
+	job->positiveIndices.clear();
+	for(int i = 0; i < numIterations; i++) {
+		job->positiveIndices.push_back(positiveIndices[i].first);
+	}
 
-	int numIterations = std::min<size_t>(positiveIndices.size(), 10); //Take at most 10 bounding boxes (sorted by overlap)
+	//The detection result is gone by the time a queued job is learned
+	job->featureVectors.clear();
+	for(size_t i = 0; i < job->negativeIndices.size(); i++) {
+		int* featureVector = &detectionResult->featureVectors[numTrees*job->negativeIndices[i]];
+		job->featureVectors.insert(job->featureVectors.end(), featureVector, featureVector + numTrees);
+	}
+	for(size_t i = 0; i < job->positiveIndices.size(); i++) {
+		int* featureVector = &detectionResult->featureVectors[numTrees*job->positiveIndices[i]];
+		job->featureVectors.insert(job->featureVectors.end(), featureVector, featureVector + numTrees);
+	}
 
-	for(size_t i = 0; i < negativeIndices.size(); i++) {
-		int idx = negativeIndices.at(i);
+	learningQueue.push(job);
+}
+
+//Updates ensemble and nn with the windows learn() picked from a frame
+void TLD::learnJob(LearningJob& job, EnsembleClassifier* ensemble, NNClassifier* nn) {
+	int numTrees = detectorCascade->numTrees;
+
+	ensemble->nextIteration(job.img); //Features skipped by earlyExit are calculated from the frame
+
+	size_t numVectors = job.negativeIndices.size() + job.positiveIndices.size();
+	int* featureVector = (numVectors > 0) ? &job.featureVectors[0] : NULL;
+
+	for(size_t i = 0; i < job.negativeIndices.size(); i++) {
 		//TODO: Somewhere here image warping might be possible
-		detectorCascade->ensembleClassifier->learn(&detectorCascade->windows[TLD_WINDOW_SIZE*idx], false, &detectionResult->featureVectors[detectorCascade->numTrees*idx]);
+		ensemble->learn(job.negativeIndices[i], false, featureVector);
+		featureVector += numTrees;
 	}
 
 	//TODO: Randomization might be a good idea
-	for(int i = 0; i < numIterations; i++) {
-		int idx = positiveIndices.at(i).first;
+	for(size_t i = 0; i < job.positiveIndices.size(); i++) {
 		//TODO: Somewhere here image warping might be possible
-		detectorCascade->ensembleClassifier->learn(&detectorCascade->windows[TLD_WINDOW_SIZE*idx], true, &detectionResult->featureVectors[detectorCascade->numTrees*idx]);
+		ensemble->learn(job.positiveIndices[i], true, featureVector);
+		featureVector += numTrees;
 	}
 
-	for(size_t i = 0; i < negativeIndicesForNN.size(); i++) {
-		int idx = negativeIndicesForNN.at(i);
+	int numNegatives = job.negativeIndicesForNN.size();
+	if((int) learningPatches.size() < 1 + numNegatives) {
+		learningPatches.resize(1 + numNegatives);
+	}
 
-		NormalizedPatch patch;
-		tldExtractNormalizedPatchBB(currImg, &detectorCascade->windows[TLD_WINDOW_SIZE*idx], patch.values);
-		patch.positive = 0;
-		patches.push_back(patch);
+	learnPatches(job.img, job.bb, numNegatives > 0 ? &job.negativeIndicesForNN[0] : NULL, numNegatives, nn, &learningPatches[0]);
+}
+
+//Lets nn learn the patch of bb in img as positive and the given windows as negatives. patches has room for all of them.
+void TLD::learnPatches(const Mat& img, const Rect& bb, const int* negativeIndices, int numNegatives, NNClassifier* nn, NormalizedPatch* patches) {
+	//This is the positive patch
+	Rect box = bb;
+	tldExtractNormalizedPatchRect(img, &box, patches[0].values);
+	patches[0].positive = 1;
+	//TODO: Flip
+
+	if(numNegatives > 0) {
+		tldExtractNormalizedPatches(img, detectorCascade->windowGrid, negativeIndices, numNegatives, &patches[1]);
+	}
+	for(int i = 1; i <= numNegatives; i++) {
+		patches[i].positive = 0;
+	}
+
+	nn->learn(patches, 1 + numNegatives);
+
+	//cout << "NN has now " << nn->truePositives->size() << " positives and " << nn->falsePositives->size() << " negatives.\n";
+}
+
+/*
+ * Makes the learning model a copy of the published one, unless it already is one but for
+ * missedJobs. Runs before the frame's sections, while nothing else touches either model, so
+ * the whole model is only copied once something other than the learning jobs has changed it.
+ */
+void TLD::prepareLearningModel() {
+	if(learningModelValid) {
+		return;
+	}
+
+	if(learningEnsemble == NULL) {
+		learningEnsemble = new EnsembleClassifier();
+		learningNNClassifier = new NNClassifier();
+	}
+
+	learningEnsemble->copyModelFrom(*detectorCascade->ensembleClassifier);
+	learningNNClassifier->copyModelFrom(*detectorCascade->nnClassifier);
+
+	learningModelValid = true;
+}
+
+//Call it whenever the published model changes other than by publishLearnedModel() and learnQueuedJobs()
+void TLD::discardLearningModel() {
+	learningModelValid = false;
+
+	for(size_t i = 0; i < missedJobs.size(); i++) {
+		learningQueue.recycle(missedJobs[i]);
+	}
+	missedJobs.clear();
+}
+
+/*
+ * Runs in a section next to processFrame(). Learns on the learning model, which nothing else
+ * touches, so the detector goes on using the published model undisturbed. The learning model
+ * first catches up on the jobs it missed while it was the published one, then learns queued
+ * jobs until the frame is done. It always learns one of them if there is one, and leaves the
+ * rest queued for the next frame.
+ */
+void TLD::learnInBackground() {
+	for(size_t i = 0; i < missedJobs.size(); i++) {
+		learnJob(*missedJobs[i], learningEnsemble, learningNNClassifier);
+		learningQueue.recycle(missedJobs[i]);
 	}
+	missedJobs.clear();
 
-	detectorCascade->nnClassifier->learn(patches);
+	for(;;) {
+		#pragma omp flush(frameDone)
+		if(frameDone && !learnedJobs.empty()) {
+			break;
+		}
 
-	//cout << "NN has now " << detectorCascade->nnClassifier->truePositives->size() << " positives and " << detectorCascade->nnClassifier->falsePositives->size() << " negatives.\n";
+		LearningJob* job = learningQueue.take();
+		if(job == NULL) {
+			break;
+		}
 
-	delete[] overlap;
+		learnJob(*job, learningEnsemble, learningNNClassifier);
+		learnedJobs.push_back(job);
+	}
+}
+
+/*
+ * Hands the model learnInBackground() updated to the detector by swapping pointers. Only call it
+ * once neither of them runs any more; the old model then has no readers left and becomes the
+ * learning model, which has yet to learn the jobs just published.
+ */
+void TLD::publishLearnedModel() {
+	if(learnedJobs.empty()) {
+		return;
+	}
+
+	learningEnsemble->copyStatisticsFrom(*detectorCascade->ensembleClassifier);
+	learningNNClassifier->copyStatisticsFrom(*detectorCascade->nnClassifier);
+
+	std::swap(detectorCascade->ensembleClassifier, learningEnsemble);
+	std::swap(detectorCascade->nnClassifier, learningNNClassifier);
+	nnClassifier = detectorCascade->nnClassifier;
+
+	missedJobs.swap(learnedJobs); //learnInBackground() emptied missedJobs
+}
+
+//Learns the queued jobs right away, on the model the detector uses
+void TLD::learnQueuedJobs() {
+	LearningJob* job;
+	while((job = learningQueue.take()) != NULL) {
+		learnJob(*job, detectorCascade->ensembleClassifier, detectorCascade->nnClassifier);
+
+		if(learningModelValid) {
+			missedJobs.push_back(job);
+		} else {
+			learningQueue.recycle(job);
+		}
+	}
 }
 
 typedef struct {
@@ -332,6 +714,8 @@ typedef struct {
 } TldExportEntry;
 
 void TLD::writeToFile(const char * path) {
+	finishLearning();
+
 	NNClassifier * nn = detectorCascade->nnClassifier;
 	EnsembleClassifier* ec = detectorCascade->ensembleClassifier;
 
@@ -382,12 +766,12 @@ void TLD::writeToFile(const char * path) {
 		vector<TldExportEntry> list;
 
 		for(int index = 0; index < pow(2.0f, ec->numFeatures); index++) {
-			int p = ec->positives[i * ec->numIndices + index];
+			int p = ec->numPositives(i, index);
 			if(p != 0) {
 				TldExportEntry entry;
 				entry.index = index;
 				entry.P = p;
-				entry.N = ec->negatives[i * ec->numIndices + index];
+				entry.N = ec->numNegatives(i, index);
 				list.push_back(entry);
 			}
 		}
@@ -403,7 +787,7 @@ void TLD::writeToFile(const char * path) {
 
 }
 
-void TLD::readFromFile(const char * path) {
+bool TLD::readFromFile(const char * path) {
 	release();
 
 	NNClassifier * nn = detectorCascade->nnClassifier;
@@ -413,7 +797,7 @@ void TLD::readFromFile(const char * path) {
 
 	if(file == NULL) {
 		printf("Error: Model not found: %s\n", path);
-		exit(1);
+		return false;
 	}
 
 	int MAX_LEN=255;
@@ -520,15 +904,340 @@ void TLD::readFromFile(const char * path) {
 		}
 	}
 
+	fclose(file);
+
+	initLoadedModel();
+
+	return true;
+}
+
+//Sets up the detector for a model that has just been read
+void TLD::initLoadedModel() {
+	discardLearningModel();
+
 	detectorCascade->initWindowsAndScales();
-	detectorCascade->initWindowOffsets();
 
 	detectorCascade->propagateMembers();
 
 	detectorCascade->initialised = true;
 
-	ec->initFeatureOffsets();
+	detectorCascade->ensembleClassifier->initFeatureOffsets();
+
+	detectorCascade->nnClassifier->syncModel();
+}
+
+bool TLD::writeToBinaryFile(const char * path) {
+	finishLearning();
+
+	NNClassifier * nn = detectorCascade->nnClassifier;
+	EnsembleClassifier* ec = detectorCascade->ensembleClassifier;
+
+	ModelFileHeader description;
+	description.objWidth = detectorCascade->objWidth;
+	description.objHeight = detectorCascade->objHeight;
+	description.minVar = detectorCascade->varianceFilter->minVar;
+	description.numTrees = ec->numTrees;
+	description.numFeatures = ec->numFeatures;
+
+	return ModelFile::write(path, description, ec->features, *nn->truePositives, *nn->falsePositives, ec->leaves);
+}
+
+/*
+ * Reads a model written by writeToBinaryFile. The ensemble classifier uses the features and
+ * leaves in the mapped file, so trackers loading the same file share them until they learn.
+ * Only the NN patches are copied, and their patch matrices rebuilt.
+ */
+bool TLD::readFromBinaryFile(const char * path) {
+	Ptr<ModelFile> modelFile = new ModelFile();
+	if(!modelFile->open(path)) {
+		return false;
+	}
+
+	release();
+
+	NNClassifier * nn = detectorCascade->nnClassifier;
+	EnsembleClassifier* ec = detectorCascade->ensembleClassifier;
+	const ModelFileHeader* header = modelFile->header();
+
+	detectorCascade->objWidth = header->objWidth;
+	detectorCascade->objHeight = header->objHeight;
+	detectorCascade->varianceFilter->minVar = header->minVar;
+
+	const int patchLength = TLD_PATCH_SIZE*TLD_PATCH_SIZE;
+
+	nn->truePositives->resize(header->numTruePositives);
+	for(int s = 0; s < header->numTruePositives; s++) {
+		NormalizedPatch& patch = nn->truePositives->at(s);
+		memcpy(patch.values, modelFile->truePositives() + patchLength*s, sizeof(float)*patchLength);
+		patch.positive = true;
+	}
+
+	nn->falsePositives->resize(header->numFalsePositives);
+	for(int s = 0; s < header->numFalsePositives; s++) {
+		NormalizedPatch& patch = nn->falsePositives->at(s);
+		memcpy(patch.values, modelFile->falsePositives() + patchLength*s, sizeof(float)*patchLength);
+		patch.positive = false;
+	}
+
+	ec->useModelFile(modelFile);
+	detectorCascade->numTrees = ec->numTrees;
+	detectorCascade->numFeatures = ec->numFeatures;
+
+	initLoadedModel();
+
+	return true;
+}
+
+static void putPatches(CheckpointRecord& record, const vector<NormalizedPatch>& patches, const vector<int>& rows) {
+	for(size_t i = 0; i < rows.size(); i++) {
+		record.put(&rows[i], sizeof(int));
+		record.put(patches[rows[i]].values, sizeof(float)*TLD_PATCH_SIZE*TLD_PATCH_SIZE);
+	}
+}
+
+//Rows to write: all of them for a full record, otherwise each changed one once
+static void checkpointRows(const vector<int>& changed, int numRows, bool full, vector<int>& rows) {
+	rows.clear();
+	if(full) {
+		for(int i = 0; i < numRows; i++) {
+			rows.push_back(i);
+		}
+	} else {
+		rows = changed;
+		sort(rows.begin(), rows.end());
+		rows.erase(unique(rows.begin(), rows.end()), rows.end());
+	}
+}
+
+/*
+ * Saves the state of the tracker to path. The first checkpoint to a path holds the whole
+ * model; every further one only appends the NN patches and fern leaves learned since the
+ * previous checkpoint, along with the current bounding box.
+ */
+bool TLD::writeCheckpoint(const char * path) {
+	finishLearning();
+
+	if(!detectorCascade->initialised) {
+		printf("Error: No model to checkpoint\n");
+		return false;
+	}
+
+	NNClassifier * nn = detectorCascade->nnClassifier;
+	EnsembleClassifier* ec = detectorCascade->ensembleClassifier;
+	bool full = (checkpointPath != path);
+
+	vector<int> truePositiveRows;
+	vector<int> falsePositiveRows;
+	checkpointRows(nn->changedTruePositives, nn->truePositives->size(), full, truePositiveRows);
+	checkpointRows(nn->changedFalsePositives, nn->falsePositives->size(), full, falsePositiveRows);
+
+	vector<int> leafIndices;
+	if(full) {
+		for(int i = 0; i < ec->numTrees * ec->numIndices; i++) {
+			if(ec->leaves[i].positives != 0 || ec->leaves[i].negatives != 0) {
+				leafIndices.push_back(i);
+			}
+		}
+	} else {
+		leafIndices = ec->changedLeaves;
+	}
+
+	CheckpointState state;
+	state.full = full;
+	state.imgWidth = detectorCascade->imgWidth;
+	state.imgHeight = detectorCascade->imgHeight;
+	state.imgWidthStep = detectorCascade->imgWidthStep;
+	state.objWidth = detectorCascade->objWidth;
+	state.objHeight = detectorCascade->objHeight;
+	state.minVar = detectorCascade->varianceFilter->minVar;
+	state.numTrees = ec->numTrees;
+	state.numFeatures = ec->numFeatures;
+	state.valid = valid;
+	state.wasValid = wasValid;
+	state.hasBB = (currBB != NULL);
+	state.bbX = state.hasBB ? currBB->x : 0;
+	state.bbY = state.hasBB ? currBB->y : 0;
+	state.bbWidth = state.hasBB ? currBB->width : 0;
+	state.bbHeight = state.hasBB ? currBB->height : 0;
+	state.currConf = currConf;
+	state.numTruePositives = nn->truePositives->size();
+	state.numFalsePositives = nn->falsePositives->size();
+	state.numChangedTruePositives = truePositiveRows.size();
+	state.numChangedFalsePositives = falsePositiveRows.size();
+	state.numChangedLeaves = leafIndices.size();
+
+	checkpointRecord.begin();
+	checkpointRecord.put(&state, sizeof(state));
+	if(full) {
+		checkpointRecord.put(ec->features, sizeof(float) * 4 * ec->numFeatures * ec->numTrees);
+	}
+	putPatches(checkpointRecord, *nn->truePositives, truePositiveRows);
+	putPatches(checkpointRecord, *nn->falsePositives, falsePositiveRows);
+	for(size_t i = 0; i < leafIndices.size(); i++) {
+		checkpointRecord.put(&leafIndices[i], sizeof(int));
+		checkpointRecord.put(&ec->leaves[leafIndices[i]], sizeof(FernLeaf));
+	}
+
+	if(!checkpointRecord.appendTo(path, full)) {
+		//The file may end in a partial record now, so start over with a full one
+		checkpointPath.clear();
+		return false;
+	}
+
+	checkpointPath = path;
+	nn->recordChanges = true;
+	ec->recordChanges = true;
+	nn->clearChanges();
+	ec->clearChanges();
+
+	return true;
+}
+
+static bool getPatches(CheckpointRecord& record, vector<NormalizedPatch>& patches, int numRows, bool positive) {
+	for(int i = 0; i < numRows; i++) {
+		int row;
+		if(!record.get(&row, sizeof(int)) || row < 0 || row >= (int) patches.size()) {
+			return false;
+		}
+		NormalizedPatch& patch = patches[row];
+		if(!record.get(patch.values, sizeof(float)*TLD_PATCH_SIZE*TLD_PATCH_SIZE)) {
+			return false;
+		}
+		patch.positive = positive;
+	}
+	return true;
+}
+
+//Applies one record read by readCheckpoint(), whose fixed part is state
+bool TLD::applyCheckpointRecord(CheckpointRecord& record, const CheckpointState& state) {
+	NNClassifier * nn = detectorCascade->nnClassifier;
+	EnsembleClassifier* ec = detectorCascade->ensembleClassifier;
+
+	if(state.full) {
+		release();
+
+		if(state.numFeatures <= 0 || state.numFeatures > 16 || state.numTrees <= 0) {
+			return false;
+		}
+
+		detectorCascade->imgWidth = state.imgWidth;
+		detectorCascade->imgHeight = state.imgHeight;
+		detectorCascade->imgWidthStep = state.imgWidthStep;
+		detectorCascade->objWidth = state.objWidth;
+		detectorCascade->objHeight = state.objHeight;
+		detectorCascade->varianceFilter->minVar = state.minVar;
+
+		ec->numTrees = state.numTrees;
+		detectorCascade->numTrees = ec->numTrees;
+		ec->numFeatures = state.numFeatures;
+		detectorCascade->numFeatures = ec->numFeatures;
+
+		int size = 2 * 2 * ec->numFeatures * ec->numTrees;
+		ec->features = new float[size];
+		ec->numIndices = 1 << ec->numFeatures;
+		ec->initPosteriors();
+
+		if(!record.get(ec->features, sizeof(float)*size)) {
+			return false;
+		}
+	} else if(state.numTrees != ec->numTrees || state.numFeatures != ec->numFeatures) {
+		return false;
+	}
+
+	if(state.numTruePositives < 0 || state.numFalsePositives < 0) {
+		return false;
+	}
+	nn->truePositives->resize(state.numTruePositives);
+	nn->falsePositives->resize(state.numFalsePositives);
+
+	if(!getPatches(record, *nn->truePositives, state.numChangedTruePositives, true)
+			|| !getPatches(record, *nn->falsePositives, state.numChangedFalsePositives, false)) {
+		return false;
+	}
+
+	for(int i = 0; i < state.numChangedLeaves; i++) {
+		int index;
+		if(!record.get(&index, sizeof(int)) || index < 0 || index >= ec->numTrees * ec->numIndices
+				|| !record.get(&ec->leaves[index], sizeof(FernLeaf))) {
+			return false;
+		}
+	}
+
+	currBBStorage = Rect(state.bbX, state.bbY, state.bbWidth, state.bbHeight);
+	currBB = state.hasBB ? &currBBStorage : NULL;
+	currConf = state.currConf;
+	valid = state.valid != 0;
+	wasValid = state.wasValid != 0;
+
+	return true;
+}
+
+/*
+ * Restores the state saved by writeCheckpoint(). Tracking resumes with the next image, which is
+ * searched by the detector only, as the image the bounding box was found in is not saved.
+ * Further checkpoints to path are appended to it, unless it ends in a damaged record; then the
+ * next checkpoint replaces it.
+ */
+bool TLD::readCheckpoint(const char * path) {
+	FILE * file = fopen(path, "rb");
+	if(file == NULL) {
+		printf("Error: Checkpoint not found: %s\n", path);
+		return false;
+	}
+
+	int numRecords = 0;
+	bool ok = true;
+	long goodEnd = 0; //Offset behind the last record applied
+	CheckpointState state;
+	while(checkpointRecord.readFrom(file)) {
+		if(!checkpointRecord.get(&state, sizeof(state)) || (numRecords == 0 && !state.full)) {
+			break;
+		}
+		if(!applyCheckpointRecord(checkpointRecord, state)) {
+			ok = false;
+			break;
+		}
+		numRecords++;
+		goodEnd = ftell(file);
+	}
+
+	//A record torn by a crash would hide everything appended behind it
+	fseek(file, 0, SEEK_END);
+	bool torn = ftell(file) != goodEnd;
+
+	fclose(file);
+
+	if(!ok || numRecords == 0) {
+		printf("Error: Checkpoint %s is corrupt\n", path);
+		release();
+		return false;
+	}
+
+	initLoadedModel();
+
+	prevImg.release();
+	currImg.release();
+	prevBB = NULL;
+
+	hasLastKnownBB = (currBB != NULL);
+	if(hasLastKnownBB) lastKnownBB = *currBB;
+	framesLost = 0;
+
+	NNClassifier * nn = detectorCascade->nnClassifier;
+	EnsembleClassifier* ec = detectorCascade->ensembleClassifier;
+	if(torn) {
+		//Replace the file by a full record with the next checkpoint
+		checkpointPath.clear();
+	}
+	else {
+		checkpointPath = path;
+	}
+	nn->recordChanges = true;
+	ec->recordChanges = true;
+	nn->clearChanges();
+	ec->clearChanges();
 
+	return true;
 }
 
 
@@ -26,23 +26,64 @@
 #ifndef TLD_H_
 #define TLD_H_
 
+#include <string>
 #include <opencv/cv.h>
 
 #include "MedianFlowTracker.h"
 #include "DetectorCascade.h"
+#include "Checkpoint.h"
+#include "LearningQueue.h"
 
 namespace tld {
 
 class TLD {
+	//Working data
+	cv::Rect prevBBStorage;
+	cv::Rect currBBStorage;
+	std::string checkpointPath; //File writeCheckpoint() appends to; empty until it holds a full record
+	CheckpointRecord checkpointRecord;
+	cv::Rect lastKnownBB; //Where the object was when it was last valid
+	bool hasLastKnownBB;
+	unsigned long prevFrameId; //Identifies prevImg in the caches of the tracker and the detector
+	unsigned long currFrameId; //Identifies currImg
+	int framesLost; //Since the object was last valid
+	bool learnPending; //learn() has yet to run for currImg, see pipelined
+	LearningQueue learningQueue; //Jobs learn() leaves to learnInBackground(), see asyncLearning
+	std::vector<LearningJob*> learnedJobs; //Learned on the learning model since it was last published
+	std::vector<LearningJob*> missedJobs; //Learned on the published model but not yet on the learning model
+	std::vector<NormalizedPatch> learningPatches; //Patches of the job being learned
+	EnsembleClassifier* learningEnsemble; //The model learnInBackground() updates; NULL until first used
+	NNClassifier* learningNNClassifier;
+	bool learningModelValid; //The learning model equals the published one but for missedJobs
+	volatile bool frameDone; //Lets learnInBackground() stop once processFrame() is done
+
 	void storeCurrentData();
 	void fuseHypotheses();
-	void learn();
+	void learn(bool queue);
+	void learnJob(LearningJob& job, EnsembleClassifier* ensemble, NNClassifier* nn);
+	void learnPatches(const cv::Mat& img, const cv::Rect& bb, const int* negativeIndices, int numNegatives, NNClassifier* nn, NormalizedPatch* patches);
+	void prepareLearningModel();
+	void discardLearningModel();
+	void learnInBackground();
+	void publishLearnedModel();
+	void learnQueuedJobs();
+	void runPendingLearn();
+	void processFrame(const cv::Mat& grey_frame, unsigned long frameId);
+	void processImagePipelined(const cv::Mat& grey_frame, unsigned long frameId);
 	void initialLearning();
+	void initLoadedModel();
+	void detect(const cv::Mat& img, unsigned long frameId);
+	bool applyCheckpointRecord(CheckpointRecord& record, const CheckpointState& state);
 public:
 	bool trackerEnabled;
 	bool detectorEnabled;
 	bool learningEnabled;
 	bool alternating;
+	bool restrictSearch; //Lets the detector scan only around the last known position while it is close by
+	float searchMargin; //Added to each side of the search region, relative to the size of the object
+	float searchGrowth; //Factor the margin grows by with every frame the object is lost
+	bool pipelined; //Tracks and detects at the same time, and learns from each frame during the next one
+	bool asyncLearning; //Learns from each frame on a second model during the next one, and then swaps the models
 
 	MedianFlowTracker* medianFlowTracker;
 	DetectorCascade* detectorCascade;
@@ -51,18 +92,26 @@ public:
 	bool wasValid;
 	cv::Mat prevImg;
 	cv::Mat currImg;
-	cv::Rect* prevBB;
-	cv::Rect* currBB;
+	cv::Rect* prevBB; //Points to prevBBStorage or is NULL
+	cv::Rect* currBB; //Points to currBBStorage or is NULL
 	float currConf;
 	bool learning;
 
 	TLD();
 	virtual ~TLD();
 	void release();
-	void selectObject(const cv::Mat& img, cv::Rect * bb);
-	void processImage(const cv::Mat& img, bool isGray = false);
+	void selectObject(const cv::Mat& img, cv::Rect * bb, unsigned long frameId = 0);
+	void processImage(const cv::Mat& img, bool isGray = false, unsigned long frameId = 0);
+	void finishLearning();
+	void trackFrame(const cv::Mat& grey_frame, unsigned long frameId);
+	bool wantsDetection() const;
+	void fuseAndLearn();
 	void writeToFile(const char * path);
-	void readFromFile(const char * path);
+	bool readFromFile(const char * path);
+	bool writeToBinaryFile(const char * path);
+	bool readFromBinaryFile(const char * path);
+	bool writeCheckpoint(const char * path);
+	bool readCheckpoint(const char * path);
 };
 
 } /* namespace tld */
@@ -45,7 +45,9 @@ void tldBoundingBoxToPoints(int * bb, CvPoint * p1, CvPoint * p2) {
 void tldNormalizeImg(const Mat& img, float * output) {
 	int size = TLD_PATCH_SIZE;
 
-	Mat result;
+	//resize writes into the buffer as long as size and type match
+	unsigned char resultData[TLD_PATCH_SIZE*TLD_PATCH_SIZE];
+	Mat result(size, size, CV_8UC1, resultData);
 	resize(img, result, cvSize(size,size)); //Default is bilinear
 
 	float mean = 0;
@@ -81,10 +83,94 @@ void tldExtractSubImage(const Mat& img, Mat& subImage, int * boundary) {
 	tldExtractSubImage(img, subImage, tldBoundaryToRect(boundary));
 }
 
+/*
+ * Where to sample a region of w*h pixels for a patch, bilinearly and with the same sample
+ * positions as cv::resize. Regions of the same size share it.
+ */
+class PatchSampler {
+	int x0[TLD_PATCH_SIZE];
+	int x1[TLD_PATCH_SIZE];
+	float ax[TLD_PATCH_SIZE];
+	int y0[TLD_PATCH_SIZE];
+	int y1[TLD_PATCH_SIZE];
+	float ay[TLD_PATCH_SIZE];
+
+	static void calcPositions(int size, int * p0, int * p1, float * alpha) {
+		float scale = size / (float) TLD_PATCH_SIZE;
+		for(int i = 0; i < TLD_PATCH_SIZE; i++) {
+			float f = (i + 0.5f) * scale - 0.5f;
+			int p = (int) floor(f);
+			float a = f - p;
+			if(p < 0) {
+				p = 0;
+				a = 0;
+			}
+			if(p >= size - 1) {
+				p = size - 1;
+				a = 0;
+			}
+			p0[i] = p;
+			p1[i] = min(p + 1, size - 1);
+			alpha[i] = a;
+		}
+	}
+
+public:
+	int width;
+	int height;
+
+	PatchSampler() : width(-1), height(-1) {}
+
+	void init(int w, int h) {
+		width = w;
+		height = h;
+		calcPositions(w, x0, x1, ax);
+		calcPositions(h, y0, y1, ay);
+	}
+
+	//Samples straight from img and subtracts the mean, output is row by row
+	void sample(const Mat& img, int x, int y, float * output) const {
+		float sum = 0;
+
+		for(int j = 0; j < TLD_PATCH_SIZE; j++) {
+			const unsigned char * row0 = img.ptr<unsigned char>(y + y0[j]) + x;
+			const unsigned char * row1 = img.ptr<unsigned char>(y + y1[j]) + x;
+			float b = ay[j];
+
+			for(int i = 0; i < TLD_PATCH_SIZE; i++) {
+				float top = row0[x0[i]] + ax[i] * (row0[x1[i]] - row0[x0[i]]);
+				float bottom = row1[x0[i]] + ax[i] * (row1[x1[i]] - row1[x0[i]]);
+				float value = top + b * (bottom - top);
+				output[j*TLD_PATCH_SIZE + i] = value;
+				sum += value;
+			}
+		}
+
+		float mean = sum / (TLD_PATCH_SIZE*TLD_PATCH_SIZE);
+		for(int k = 0; k < TLD_PATCH_SIZE*TLD_PATCH_SIZE; k++) {
+			output[k] -= mean;
+		}
+	}
+};
+
+//The region must lie inside img, which must be greyscale
 void tldExtractNormalizedPatch(const Mat& img, int x, int y, int w, int h, float * output) {
-	Mat subImage;
-	tldExtractSubImage(img, subImage, Rect(x,y,w,h));
-	tldNormalizeImg(subImage, output);
+	PatchSampler sampler;
+	sampler.init(w, h);
+	sampler.sample(img, x, y, output);
+}
+
+//Extracts the patches of several windows. Consecutive windows of the same size share the sample positions.
+void tldExtractNormalizedPatches(const Mat& img, const WindowGrid * windowGrid, const int * windowIndices, int count, NormalizedPatch * patches) {
+	PatchSampler sampler;
+	int buffer[TLD_WINDOW_SIZE];
+	for(int k = 0; k < count; k++) {
+		int * bb = windowGrid->window(windowIndices[k], buffer);
+		if(bb[2] != sampler.width || bb[3] != sampler.height) {
+			sampler.init(bb[2], bb[3]);
+		}
+		sampler.sample(img, bb[0], bb[1], patches[k].values);
+	}
 }
 
 //TODO: Rename
@@ -136,11 +222,14 @@ float tldBBOverlap(int *bb1, int *bb2) {
 	return intersection / (float)(area1 + area2 - intersection);
 }
 
-void tldOverlapOne(int * windows, int numWindows, int index, vector<int> * indices, float * overlap) {
+void tldOverlapOne(const WindowGrid * windowGrid, int index, vector<int> * indices, float * overlap) {
+	int buffer1[TLD_WINDOW_SIZE];
+	int buffer2[TLD_WINDOW_SIZE];
+	int * bb = windowGrid->window(index, buffer1);
 
 	for(size_t i = 0; i < indices->size(); i++) {
 
-		overlap[i] = tldBBOverlap(&windows[TLD_WINDOW_SIZE*index], &windows[TLD_WINDOW_SIZE*indices->at(i)]);
+		overlap[i] = tldBBOverlap(bb, windowGrid->window(indices->at(i), buffer2));
 	}
 
 }
@@ -163,21 +252,33 @@ Rect* tldCopyRect(Rect* r) {
 	return r2;
 }
 
-void tldOverlapRect(int * windows, int numWindows, Rect * boundary, float * overlap) {
+void tldOverlapRect(const WindowGrid * windowGrid, Rect * boundary, float * overlap) {
 	int bb[4];
 	bb[0] = boundary->x;
 	bb[1] = boundary->y;
 	bb[2] = boundary->width;
 	bb[3] = boundary->height;
 
-	tldOverlap(windows, numWindows, bb, overlap);
+	tldOverlap(windowGrid, bb, overlap);
 }
 
-void tldOverlap(int * windows, int numWindows, int * boundary, float * overlap) {
-
-	for(int i = 0; i < numWindows; i++) {
-
-		overlap[i] = tldBBOverlap(boundary, &windows[TLD_WINDOW_SIZE*i]);
+//Walks the windows scale by scale, so it works the same whether they are stored or not
+void tldOverlap(const WindowGrid * windowGrid, int * boundary, float * overlap) {
+
+	for(int s = 0; s < windowGrid->numScales; s++) {
+		const ScaleGrid& grid = windowGrid->scaleGrids[s];
+		float * out = overlap + grid.firstWindow;
+		int bb[4];
+		bb[2] = grid.width;
+		bb[3] = grid.height;
+
+		for(int row = 0; row < grid.numY; row++) {
+			bb[1] = grid.y + row*grid.stepY;
+			for(int col = 0; col < grid.numX; col++) {
+				bb[0] = grid.x + col*grid.stepX;
+				*out++ = tldBBOverlap(boundary, bb);
+			}
+		}
 	}
 
 }
@@ -197,4 +298,26 @@ int tldIsInside(int * bb1, int * bb2) {
 	} else return 0;
 
 }
+
+//Updates the Adler-32 checksum adler, which starts at 1, with size bytes of data
+unsigned int tldAdler32(unsigned int adler, const void * data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*) data;
+	unsigned int a = adler & 0xFFFF;
+	unsigned int b = adler >> 16;
+
+	while(size > 0) {
+		//5552 bytes is the most that can be summed before b might overflow
+		size_t n = (size < 5552) ? size : 5552;
+		size -= n;
+		for(size_t i = 0; i < n; i++) {
+			a += bytes[i];
+			b += a;
+		}
+		bytes += n;
+		a %= 65521;
+		b %= 65521;
+	}
+
+	return (b << 16) | a;
+}
 } /* End Namespace */
@@ -29,8 +29,12 @@
 #include <utility>
 #include <opencv/cv.h>
 
+#include "NormalizedPatch.h"
+
 namespace tld {
 
+struct WindowGrid;
+
 template <class T1, class T2>
 void tldConvertBB(T1 * src, T2 * dest) {
 	dest[0] = src[0];
@@ -89,6 +93,7 @@ void tldNormalizeImg(const cv::Mat& img, float * result, int size);
 void tldExtractNormalizedPatch(const cv::Mat& img, int x, int y, int w, int h, float * output);
 void tldExtractNormalizedPatchBB(const cv::Mat& img, int * boundary, float * output);
 void tldExtractNormalizedPatchRect(const cv::Mat& img, cv::Rect* rect, float * output);
+void tldExtractNormalizedPatches(const cv::Mat& img, const WindowGrid * windowGrid, const int * windowIndices, int count, NormalizedPatch * patches);
 void tldExtractSubImage(const cv::Mat& img, cv::Mat& subImage, int * boundary);
 void tldExtractSubImage(const cv::Mat& img, cv::Mat& subImage, int x, int y, int w, int h);
 
@@ -100,12 +105,15 @@ cv::Rect* tldCopyRect(cv::Rect* r);
 
 //TODO: Change function names
 float tldOverlapRectRect(cv::Rect r1, cv::Rect r2);
-void tldOverlapOne(int * windows, int numWindows, int index, std::vector<int> * indices, float * overlap);
-void tldOverlap(int * windows, int numWindows, int * boundary, float * overlap);
-void tldOverlapRect(int * windows, int numWindows, cv::Rect * boundary, float * overlap);
+float tldBBOverlap(int *bb1, int *bb2);
+void tldOverlapOne(const WindowGrid * windowGrid, int index, std::vector<int> * indices, float * overlap);
+void tldOverlap(const WindowGrid * windowGrid, int * boundary, float * overlap);
+void tldOverlapRect(const WindowGrid * windowGrid, cv::Rect * boundary, float * overlap);
 
 float tldCalcVariance(float * value, int n);
 
+unsigned int tldAdler32(unsigned int adler, const void * data, size_t size);
+
 #endif /* UTIL_H_ */
 
 } /* End Namespace */
@@ -34,8 +34,8 @@ namespace tld {
 VarianceFilter::VarianceFilter() {
 	enabled = true;
 	minVar = 0;
-	integralImg = NULL;
-	integralImg_squared = NULL;
+	integralImages = NULL;
+	integralImageCache = new IntegralImageCache();
 }
 
 VarianceFilter::~VarianceFilter() {
@@ -43,39 +43,35 @@ VarianceFilter::~VarianceFilter() {
 }
 
 void VarianceFilter::release() {
-	if(integralImg != NULL) delete integralImg;
-	integralImg = NULL;
-
-	if(integralImg_squared != NULL) delete integralImg_squared;
-	integralImg_squared = NULL;
+	if(integralImages != NULL) integralImageCache->release(integralImages);
+	integralImages = NULL;
 }
 
 float VarianceFilter::calcVariance(int *off) {
 
-	int * ii1 = integralImg->data;
-	long long * ii2 = integralImg_squared->data;
+	int * ii1 = integralImages->product.integralImg->data;
+	long long * ii2 = integralImages->product.integralImg_squared->data;
 
 	float mX  = (ii1[off[3]] - ii1[off[2]] - ii1[off[1]] + ii1[off[0]]) / (float) off[5]; //Sum of Area divided by area
 	float mX2 = (ii2[off[3]] - ii2[off[2]] - ii2[off[1]] + ii2[off[0]]) / (float) off[5];
 	return mX2 - mX*mX;
 }
 
-void VarianceFilter::nextIteration(const Mat& img) {
+//frameId identifies img in integralImageCache, see tldNewFrameId()
+void VarianceFilter::nextIteration(const Mat& img, unsigned long frameId) {
 	if(!enabled) return;
 
+	//Of the filters sharing the cache, whichever gets here first builds the integral images of img
 	release();
-
-	integralImg = new IntegralImage<int>(img.size());
-	integralImg->calcIntImg(img);
-
-	integralImg_squared = new IntegralImage<long long>(img.size());
-	integralImg_squared->calcIntImg(img, true);
+	integralImages = integralImageCache->acquire(frameId);
+	integralImageCache->build(integralImages, img);
 }
 
 bool VarianceFilter::filter(int i) {
 	if(!enabled) return true;
 
-	float bboxvar = calcVariance(windowOffsets + TLD_WINDOW_OFFSET_SIZE*i);
+	int off[TLD_WINDOW_OFFSET_SIZE];
+	float bboxvar = calcVariance(windowGrid->offsets(i, off));
 
 	detectionResult->variances[i] = bboxvar;
 
@@ -27,18 +27,19 @@
 #define VARIANCEFILTER_H_
 
 #include <opencv/cv.h>
-#include "IntegralImage.h"
+#include "IntegralImageCache.h"
 #include "DetectionResult.h"
+#include "WindowGridCache.h"
 
 namespace tld {
 
 class VarianceFilter {
-	IntegralImage<int>* integralImg;
-	IntegralImage<long long>* integralImg_squared;
+	IntegralImageCache::Entry* integralImages; //Of the current frame, acquired from integralImageCache
 
 public:
 	bool enabled;
-	int * windowOffsets;
+	cv::Ptr<IntegralImageCache> integralImageCache;
+	WindowGrid* windowGrid;
 
 	DetectionResult * detectionResult;
 
@@ -48,7 +49,7 @@ public:
 	virtual ~VarianceFilter();
 
 	void release();
-	void nextIteration(const cv::Mat& img);
+	void nextIteration(const cv::Mat& img, unsigned long frameId);
 	bool filter(int idx);
 	float calcVariance(int *off);
 };
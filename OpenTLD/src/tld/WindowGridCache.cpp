@@ -0,0 +1,287 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * WindowGridCache.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "WindowGridCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "TLDUtil.h"
+
+using namespace std;
+using namespace cv;
+
+namespace tld {
+
+//TODO: Convert this to a function
+#define sub2idx(x,y,imgWidthStep) ((int) (floor((x)+0.5) + floor((y)+0.5)*(imgWidthStep)))
+
+bool WindowGridKey::operator==(const WindowGridKey& other) const {
+	return imgWidth == other.imgWidth && imgHeight == other.imgHeight && imgWidthStep == other.imgWidthStep
+			&& objWidth == other.objWidth && objHeight == other.objHeight
+			&& minScale == other.minScale && maxScale == other.maxScale && minSize == other.minSize
+			&& useShift == other.useShift && shift == other.shift
+			&& numFeatures == other.numFeatures && numTrees == other.numTrees
+			&& implicit == other.implicit;
+}
+
+//Scales are stored in the order of their windows, so the last one starting at or before windowIdx has it
+int WindowGrid::scaleOf(int windowIdx) const {
+	int low = 0;
+	int high = numScales - 1;
+	while(low < high) {
+		int mid = (low + high + 1) / 2;
+		if(scaleGrids[mid].firstWindow <= windowIdx) {
+			low = mid;
+		} else {
+			high = mid - 1;
+		}
+	}
+	return low;
+}
+
+void WindowGrid::decodeWindow(int windowIdx, int* bb) const {
+	int scaleIndex = scaleOf(windowIdx);
+	const ScaleGrid& grid = scaleGrids[scaleIndex];
+	int k = windowIdx - grid.firstWindow;
+
+	bb[0] = grid.x + (k % grid.numX) * grid.stepX;
+	bb[1] = grid.y + (k / grid.numX) * grid.stepY;
+	bb[2] = grid.width;
+	bb[3] = grid.height;
+	bb[4] = scaleIndex;
+}
+
+//Same as initWindowOffsets below, for a single window
+void WindowGrid::decodeOffsets(int windowIdx, int* off) const {
+	int bb[TLD_WINDOW_SIZE];
+	decodeWindow(windowIdx, bb);
+
+	int step = key.imgWidthStep;
+	off[0] = (bb[0]-1) + (bb[1]-1)*step;
+	off[1] = (bb[0]-1) + (bb[1]+bb[3]-1)*step;
+	off[2] = (bb[0]+bb[2]-1) + (bb[1]-1)*step;
+	off[3] = (bb[0]+bb[2]-1) + (bb[1]+bb[3]-1)*step;
+	off[4] = bb[4]*2*key.numFeatures*key.numTrees;
+	off[5] = bb[2]*bb[3];
+}
+
+/* returns number of bounding boxes, bounding boxes, number of scales, scales
+ * bounding boxes are stored in an array of size 5*numBBs using the format <x y w h scaleIndex>
+ * scales are stored using the format <w h>
+ *
+ */
+static void initWindowsAndScales(WindowGrid* grid) {
+	const WindowGridKey& key = grid->key;
+
+	int scanAreaX = 1; // It is important to start with 1/1, because the integral images aren't defined at pos(-1,-1) due to speed reasons
+	int scanAreaY = 1;
+	int scanAreaW = key.imgWidth-1;
+	int scanAreaH = key.imgHeight-1;
+
+	int windowIndex = 0;
+
+	grid->scales = new Size[key.maxScale-key.minScale+1];
+
+	int numWindows = 0;
+
+	int scaleIndex = 0;
+	for(int i = key.minScale; i <= key.maxScale; i++) {
+		float scale = pow(1.2,i);
+		int w = (int)key.objWidth*scale;
+		int h = (int)key.objHeight*scale;
+		int ssw,ssh;
+		if(key.useShift) {
+			ssw = max<float>(1,w*key.shift);
+			ssh = max<float>(1,h*key.shift);
+		} else {
+			ssw = 1;
+			ssh = 1;
+		}
+
+		if(w < key.minSize || h < key.minSize || w > scanAreaW || h > scanAreaH) continue;
+
+		grid->scales[scaleIndex].width = w;
+		grid->scales[scaleIndex].height = h;
+
+		scaleIndex++;
+
+		numWindows += floor((float)(scanAreaW - w + ssw)/ssw)*floor((float)(scanAreaH - h + ssh) / ssh);
+	}
+
+	grid->numScales = scaleIndex;
+	grid->numWindows = numWindows;
+
+	int* windows = key.implicit ? NULL : new int[TLD_WINDOW_SIZE*numWindows];
+	grid->windows = windows;
+	grid->scaleGrids = new ScaleGrid[grid->numScales];
+
+	for(scaleIndex = 0; scaleIndex < grid->numScales; scaleIndex++) {
+		int w = grid->scales[scaleIndex].width;
+		int h = grid->scales[scaleIndex].height;
+
+		int ssw,ssh;
+		if(key.useShift) {
+			ssw = max<float>(1,w*key.shift);
+			ssh = max<float>(1,h*key.shift);
+		} else {
+			ssw = 1;
+			ssh = 1;
+		}
+
+		ScaleGrid& scaleGrid = grid->scaleGrids[scaleIndex];
+		scaleGrid.firstWindow = windowIndex;
+		scaleGrid.x = scanAreaX;
+		scaleGrid.y = scanAreaY;
+		scaleGrid.width = w;
+		scaleGrid.height = h;
+		scaleGrid.stepX = ssw;
+		scaleGrid.stepY = ssh;
+		scaleGrid.numX = 0;
+		scaleGrid.numY = 0;
+
+		for(int y = scanAreaY; y + h <= scanAreaY +scanAreaH; y+=ssh) {
+			scaleGrid.numX = 0;
+			for(int x = scanAreaX; x + w <= scanAreaX + scanAreaW; x+=ssw) {
+				if(windows != NULL) {
+					int * bb = &windows[TLD_WINDOW_SIZE*windowIndex];
+					tldCopyBoundaryToArray<int>(x,y,w,h, bb);
+					bb[4] = scaleIndex;
+				}
+
+				windowIndex++;
+				scaleGrid.numX++;
+			}
+			scaleGrid.numY++;
+		}
+
+	}
+
+	assert(windowIndex == numWindows);
+}
+
+//Creates offsets that can be added to bounding boxes
+//offsets are contained in the form delta11, delta12,... (combined index of dw and dh)
+//Order: scale->tree->feature
+static void initWindowOffsets(WindowGrid* grid) {
+	const WindowGridKey& key = grid->key;
+
+	if(key.implicit) {
+		grid->windowOffsets = NULL;
+		return;
+	}
+
+	grid->windowOffsets = new int[TLD_WINDOW_OFFSET_SIZE*grid->numWindows];
+	int *off = grid->windowOffsets;
+
+	int windowSize = TLD_WINDOW_SIZE;
+
+	for (int i = 0; i < grid->numWindows; i++) {
+
+		int *window = grid->windows+windowSize*i;
+		*off++ = sub2idx(window[0]-1,window[1]-1,key.imgWidthStep); // x1-1,y1-1
+		*off++ = sub2idx(window[0]-1,window[1]+window[3]-1,key.imgWidthStep); // x1-1,y2
+		*off++ = sub2idx(window[0]+window[2]-1,window[1]-1,key.imgWidthStep); // x2,y1-1
+		*off++ = sub2idx(window[0]+window[2]-1,window[1]+window[3]-1,key.imgWidthStep); // x2,y2
+		*off++ = window[4]*2*key.numFeatures*key.numTrees; // pointer to features for this scale
+		*off++ = window[2]*window[3];//Area of bounding box
+	}
+}
+
+static void deleteGrid(WindowGrid* grid) {
+	delete[] grid->windows;
+	delete[] grid->windowOffsets;
+	delete[] grid->scales;
+	delete[] grid->scaleGrids;
+	delete grid;
+}
+
+WindowGridCache::WindowGridCache() {
+#ifdef _OPENMP
+	omp_init_lock(&gridsLock);
+#endif
+}
+
+WindowGridCache::~WindowGridCache() {
+	for(size_t i = 0; i < grids.size(); i++) {
+		deleteGrid(grids[i]);
+	}
+#ifdef _OPENMP
+	omp_destroy_lock(&gridsLock);
+#endif
+}
+
+/*
+ * Returns the grid for key, building it if nobody uses one yet.
+ * Building holds the lock, so detectors asking for the same grid at once build it only once.
+ */
+WindowGrid* WindowGridCache::acquire(const WindowGridKey& key) {
+#ifdef _OPENMP
+	omp_set_lock(&gridsLock);
+#endif
+
+	WindowGrid* grid = NULL;
+	for(size_t i = 0; i < grids.size(); i++) {
+		if(grids[i]->key == key) {
+			grid = grids[i];
+			break;
+		}
+	}
+
+	if(grid == NULL) {
+		grid = new WindowGrid();
+		grid->key = key;
+		grid->users = 0;
+		initWindowsAndScales(grid);
+		initWindowOffsets(grid);
+		grids.push_back(grid);
+	}
+
+	grid->users++;
+
+#ifdef _OPENMP
+	omp_unset_lock(&gridsLock);
+#endif
+	return grid;
+}
+
+//Frees grid once no one uses it any more
+void WindowGridCache::release(WindowGrid* grid) {
+#ifdef _OPENMP
+	omp_set_lock(&gridsLock);
+#endif
+
+	grid->users--;
+	if(grid->users == 0) {
+		grids.erase(find(grids.begin(), grids.end(), grid));
+		deleteGrid(grid);
+	}
+
+#ifdef _OPENMP
+	omp_unset_lock(&gridsLock);
+#endif
+}
+
+} /* namespace tld */
@@ -0,0 +1,137 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * WindowGridCache.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef WINDOWGRIDCACHE_H_
+#define WINDOWGRIDCACHE_H_
+
+#include <opencv/cv.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace tld {
+
+//Constants
+static const int TLD_WINDOW_SIZE = 5;
+static const int TLD_WINDOW_OFFSET_SIZE = 6;
+
+//Windows of one scale, numX*numY of them stored row by row from firstWindow on
+struct ScaleGrid {
+	int firstWindow;
+	int x; //Position of the first window
+	int y;
+	int width;
+	int height;
+	int stepX;
+	int stepY;
+	int numX;
+	int numY;
+};
+
+//Everything the windows and their offsets depend on
+struct WindowGridKey {
+	int imgWidth;
+	int imgHeight;
+	int imgWidthStep;
+	int objWidth;
+	int objHeight;
+	int minScale;
+	int maxScale;
+	int minSize;
+	bool useShift;
+	float shift;
+	int numFeatures;
+	int numTrees;
+	bool implicit; //Don't store windows and windowOffsets, but decode them from scaleGrids
+
+	bool operator==(const WindowGridKey& other) const;
+};
+
+/*
+ * The sliding windows of a detector. A window is <x y w h scaleIndex>, its offsets are
+ * TLD_WINDOW_OFFSET_SIZE ints: the positions of its corners in the integral images, the
+ * offset of its scale's features and its area. Never changes once built.
+ * Unless the key is implicit, both are stored, 44 bytes per window. Implicit grids compute
+ * them from scaleGrids when asked for, so they take next to no memory, and scanning
+ * costs some arithmetic per window instead of memory traffic.
+ */
+struct WindowGrid {
+	WindowGridKey key;
+	int numWindows;
+	int* windows; //NULL if implicit
+	int* windowOffsets; //NULL if implicit
+	int numScales;
+	cv::Size* scales;
+	ScaleGrid* scaleGrids; //One per scale
+	int users; //Number of acquire calls not yet released
+
+	int scaleOf(int windowIdx) const;
+	void decodeWindow(int windowIdx, int* bb) const;
+	void decodeOffsets(int windowIdx, int* off) const;
+
+	//Returns the window, either where it is stored or decoded into bb, which has room for TLD_WINDOW_SIZE ints
+	int* window(int windowIdx, int* bb) const {
+		if(windows != NULL) return windows + TLD_WINDOW_SIZE*windowIdx;
+		decodeWindow(windowIdx, bb);
+		return bb;
+	}
+
+	//Returns the offsets of the window, either where they are stored or decoded into off,
+	//which has room for TLD_WINDOW_OFFSET_SIZE ints
+	int* offsets(int windowIdx, int* off) const {
+		if(windowOffsets != NULL) return windowOffsets + TLD_WINDOW_OFFSET_SIZE*windowIdx;
+		decodeOffsets(windowIdx, off);
+		return off;
+	}
+};
+
+/*
+ * Shares window grids between detectors that scan images of the same size for objects
+ * of the same size, which would otherwise each build and keep their own copy.
+ * A grid is built by the first acquire call asking for it and freed when its last
+ * user releases it.
+ */
+class WindowGridCache {
+public:
+	WindowGridCache();
+	~WindowGridCache();
+
+	WindowGrid* acquire(const WindowGridKey& key);
+	void release(WindowGrid* grid);
+
+private:
+	std::vector<WindowGrid*> grids;
+
+#ifdef _OPENMP
+	omp_lock_t gridsLock;
+#endif
+
+	WindowGridCache(const WindowGridCache&);
+	WindowGridCache& operator=(const WindowGridCache&);
+};
+
+} /* namespace tld */
+#endif /* WINDOWGRIDCACHE_H_ */
@@ -0,0 +1,134 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * WorkingSet.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include "WorkingSet.h"
+
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace tld {
+
+//Alignment of every allocation, enough for SSE
+static const size_t ALIGNMENT = 16;
+
+static size_t alignSize(size_t size) {
+	return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+WorkingSet::WorkingSet() {
+	block = NULL;
+	blockSize = 0;
+	used = 0;
+	overflow = NULL;
+	overflowSize = 0;
+	allocations = 0;
+}
+
+WorkingSet::~WorkingSet() {
+	release();
+}
+
+void* WorkingSet::allocBytes(size_t size) {
+	size = alignSize(size);
+
+	if(used + size <= blockSize) {
+		void* p = block + used;
+		used += size;
+		return p;
+	}
+
+	//The header is padded, so the data stays aligned
+	size_t headerSize = alignSize(sizeof(Overflow));
+	char* mem = (char*) malloc(headerSize + size + ALIGNMENT);
+	if(mem == NULL) {
+		throw std::bad_alloc();
+	}
+	allocations++;
+	tldCountAllocation();
+
+	Overflow* o = (Overflow*) mem;
+	o->next = overflow;
+	overflow = o;
+	overflowSize += size;
+
+	size_t offset = headerSize;
+	while(((size_t) (mem + offset)) % ALIGNMENT != 0) {
+		offset++;
+	}
+	return mem + offset;
+}
+
+/*
+ * Frees everything allocated since the last reset.
+ * If the block was too small, it is replaced by one that can hold all of it.
+ */
+void WorkingSet::reset() {
+	if(overflow != NULL) {
+		size_t newSize = blockSize + overflowSize;
+		release();
+
+		//Leave room for aligning the start of the block
+		blockSize = newSize + ALIGNMENT;
+		block = (char*) malloc(blockSize);
+		if(block == NULL) {
+			throw std::bad_alloc();
+		}
+		allocations++;
+		tldCountAllocation();
+	}
+
+	used = 0;
+	while(block != NULL && ((size_t) (block + used)) % ALIGNMENT != 0) {
+		used++;
+	}
+}
+
+/*
+ * Frees all memory.
+ */
+void WorkingSet::release() {
+	while(overflow != NULL) {
+		Overflow* next = overflow->next;
+		free(overflow);
+		overflow = next;
+	}
+	overflowSize = 0;
+
+	free(block);
+	block = NULL;
+	blockSize = 0;
+	used = 0;
+}
+
+/*
+ * Returns the number of heap allocations done so far by this WorkingSet.
+ * tldNumAllocations() counts those of the whole process.
+ */
+unsigned long WorkingSet::numAllocations() const {
+	return allocations;
+}
+
+} /* namespace tld */
@@ -0,0 +1,76 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * WorkingSet.h
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef WORKINGSET_H_
+#define WORKINGSET_H_
+
+#include <cstddef>
+
+namespace tld {
+
+/*
+ * Arena for the scratch memory needed while processing a frame.
+ *
+ * Allocations are taken from one block and are all freed at once by reset(),
+ * which is called once per frame. If the block runs out, additional blocks are
+ * allocated from the heap; the next reset() replaces them all by a single block
+ * big enough for the whole frame. After a few frames, processing a frame does
+ * not touch the heap anymore, which numAllocations() can be used to check.
+ * Its allocations are also counted by tldNumAllocations().
+ *
+ * The memory is not initialised and no constructors are run, so only use this
+ * for plain data. A WorkingSet is not thread-safe.
+ */
+class WorkingSet {
+	struct Overflow {
+		Overflow* next;
+	};
+
+	char* block;
+	size_t blockSize;
+	size_t used;
+	Overflow* overflow; //Blocks allocated since the last reset because block was full
+	size_t overflowSize;
+	unsigned long allocations;
+
+	void* allocBytes(size_t size);
+
+	WorkingSet(const WorkingSet&);
+	WorkingSet& operator=(const WorkingSet&);
+public:
+	WorkingSet();
+	~WorkingSet();
+
+	template <class T>
+	T* alloc(size_t n) {
+		return static_cast<T*>(allocBytes(n * sizeof(T)));
+	}
+
+	void reset();
+	void release();
+	unsigned long numAllocations() const;
+};
+
+} /* namespace tld */
+#endif /* WORKINGSET_H_ */
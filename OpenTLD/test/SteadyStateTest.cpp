@@ -0,0 +1,120 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * SteadyStateTest.cpp
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+/*
+ * Runs TLD on a synthetic sequence and checks that, once warmed up, processing
+ * a frame does not allocate from the heap. Needs a build with
+ * TLD_COUNT_ALLOCATIONS defined, like the debug build; otherwise it is skipped.
+ * The NN model gets a capacity, so learning cannot grow it without bound, and
+ * the detector runs on one thread, so its buffers do not depend on scheduling.
+ */
+
+#include <cstdio>
+
+#include <opencv/cv.h>
+
+#include "AllocationCounter.h"
+#include "TLD.h"
+
+using namespace cv;
+
+static const int WIDTH = 320;
+static const int HEIGHT = 240;
+static const int OBJECT_SIZE = 48;
+static const int PERIOD = 8; //The object moves back and forth over this many frames
+static const int WARMUP_FRAMES = 40;
+static const int MEASURED_FRAMES = 40;
+static const int NN_CAPACITY = 64; //Patches per class
+
+//A textured object moving over a textured background
+static void renderFrames(Mat* frames, Rect& initialBB) {
+	Mat background(HEIGHT, WIDTH, CV_8UC1);
+	Mat object(OBJECT_SIZE, OBJECT_SIZE, CV_8UC1);
+	RNG rng(42);
+	rng.fill(background, RNG::UNIFORM, Scalar(0), Scalar(128));
+	rng.fill(object, RNG::UNIFORM, Scalar(128), Scalar(256));
+	GaussianBlur(background, background, Size(5, 5), 0);
+	GaussianBlur(object, object, Size(3, 3), 0);
+
+	for(int i = 0; i < PERIOD; i++) {
+		int step = (i < PERIOD / 2) ? i : PERIOD - i;
+		Rect bb(100 + 4 * step, 90 + 2 * step, OBJECT_SIZE, OBJECT_SIZE);
+
+		background.copyTo(frames[i]);
+		Mat target = frames[i](bb);
+		object.copyTo(target);
+
+		if(i == 0) {
+			initialBB = bb;
+		}
+	}
+}
+
+int main() {
+	if(!tld::tldCountsAllocations()) {
+		printf("skipped: built without TLD_COUNT_ALLOCATIONS\n");
+		return 0;
+	}
+
+	Mat frames[PERIOD];
+	Rect bb;
+	renderFrames(frames, bb);
+
+	tld::TLD* tld = new tld::TLD();
+	tld->detectorCascade->imgWidth = WIDTH;
+	tld->detectorCascade->imgHeight = HEIGHT;
+	tld->detectorCascade->imgWidthStep = frames[0].step;
+	tld->detectorCascade->numThreads = 1;
+	tld->detectorCascade->nnClassifier->capacity = NN_CAPACITY;
+	tld->selectObject(frames[0], &bb);
+
+	for(int i = 1; i <= WARMUP_FRAMES; i++) {
+		tld->processImage(frames[i % PERIOD], true);
+	}
+
+	unsigned long before = tld::tldNumAllocations();
+
+	for(int i = 1; i <= MEASURED_FRAMES; i++) {
+		tld->processImage(frames[(WARMUP_FRAMES + i) % PERIOD], true);
+	}
+
+	unsigned long allocations = tld::tldNumAllocations() - before;
+	bool found = tld->currBB != NULL;
+
+	delete tld;
+
+	printf("%lu heap allocations in %d frames\n", allocations, MEASURED_FRAMES);
+
+	if(!found) {
+		printf("FAILED: lost the object\n");
+		return 1;
+	}
+
+	if(allocations != 0) {
+		printf("FAILED: steady-state frames allocated from the heap\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -2,6 +2,7 @@
 #include "RotatedRect.h"
 #include "Rect.h"
 #include "Shape.h"
+#include "FrameContext.h"
 #include <cv.h>
 #include <algorithm>
 #include <iostream>
@@ -33,13 +34,14 @@ CamShiftTracker::CamShiftTracker(int bins, int sMin, int vMin, int vMax):
 		_sMin(sMin),
 		_vMin(std::min(vMin, vMax)),
 		_vMax(std::max(vMin, vMax)) {
+	objectSlots.attach(hists);
+	objectSlots.attach(shapes);
+	objectSlots.attach(masks);
 }
 
 /*! \sa Tracker::start
 */
 int CamShiftTracker::start(const TrainingInfo* ti, int idx) {
-	assert(shapes.size() == masks.size() && masks.size() == hists.size());
-
 	if(ti == NULL || ti->img.rows <= 0 || ti->img.cols <= 0 || ti->shapes.empty()) {
 		std::cerr << "ERROR: CamShiftTracker::start: TrainingInfo has "
 			"no objects." << std::endl;
@@ -55,13 +57,15 @@ int CamShiftTracker::start(const TrainingInfo* ti, int idx) {
 	if(idx < 0)
 		idx = shapes.size();
 
+	FrameContext frame(ti->img);
+	const cv::Mat& hsv = frame.hsv();
+
 	for(size_t i = 0; i < ti->shapes.size(); i++) {
+		if(static_cast<size_t>(idx) + i == objectSlots.size())
+			objectSlots.add();
+
 		// CamShift prep
-		cv::Mat& newMask = updateListElement(masks, idx + i, 
-			static_cast<cv::Mat>(cv::Mat::zeros(ti->img.rows, ti->img.cols, CV_8UC1)));	
-		
-		cv::Mat hsv;
-		cv::cvtColor(ti->img, hsv, CV_RGB2HSV);		
+		cv::Mat& newMask = masks[idx + i] = cv::Mat::zeros(ti->img.rows, ti->img.cols, CV_8UC1);
 
 		// Threshold both saturation and value. See constructor docs for details.
 
@@ -70,7 +74,7 @@ int CamShiftTracker::start(const TrainingInfo* ti, int idx) {
 		cv::inRange(hsv, cv::Scalar(0, _sMin, _vMin, 0), cv::Scalar(181, 256, _vMax, 0), newMask);
 	
 		// Calculate the hue histogram for the object's region
-		cv::MatND& newHist = updateListElement(hists, idx + i, cv::MatND());
+		cv::MatND& newHist = hists[idx + i] = cv::MatND();
 		Rect searchWindow = ti->shapes[0]->boundingRect();
 		sanitizeWindow(searchWindow, ti->img.cols, ti->img.rows);
 		cv::Mat maskROI = newMask(searchWindow);
@@ -86,7 +90,7 @@ int CamShiftTracker::start(const TrainingInfo* ti, int idx) {
 		cv::minMaxLoc(newHist, NULL, &histMax);
 		newHist *= histMax > 0 ? 255.0 / histMax : 0.0;
 
-		updateListElement(shapes, idx + i, RotatedRect(searchWindow));
+		shapes[idx + i] = RotatedRect(searchWindow);
 	}
 
 	started = true;
@@ -97,56 +101,51 @@ int CamShiftTracker::start(const TrainingInfo* ti, int idx) {
 /*! \sa Tracker::feed
 */
 int CamShiftTracker::feed(const cv::Mat& img) {
-	assert(shapes.size() == masks.size() && masks.size() == hists.size());
+	FrameContext frame(img);
+	return feed(frame);
+}
 
+/*! Uses the frame's HSV image.
+	\sa Tracker::feed
+*/
+int CamShiftTracker::feed(FrameContext& frame) {
 	if(!started) {
 		std::cerr << "ERROR: CamShiftTracker::feed: need to call start() first." << std::endl;
 		return NO_HINT;
 	}
 
-	cv::Mat hsv;
-	cv::cvtColor(img, hsv, CV_RGB2HSV);
+	const cv::Mat& hsv = frame.hsv();
 
-	std::list<cv::MatND>::const_iterator hIterator = hists.begin();
-	std::list<cv::Mat>::iterator mIterator = masks.begin();
-	std::list<RotatedRect>::iterator sIterator = shapes.begin();
-	for(; hIterator != hists.end(); hIterator++, mIterator++, sIterator++) {	
+	for(size_t i = 0; i < objectSlots.size(); i++) {	
 		cv::inRange(hsv, cv::Scalar(0, _sMin, _vMin, 0), 
-				cv::Scalar(181, 256, _vMax, 0), *mIterator);
+				cv::Scalar(181, 256, _vMax, 0), masks[i]);
 
 		int channel = 0;
 		float range[] = {0, 256};
 		const float* ranges[] = {range};
 		cv::Mat bp;
-		cv::calcBackProject(&hsv, 1, &channel, *hIterator, bp, ranges);	
-		cv::bitwise_and(bp, *mIterator, bp);
-		Rect searchWindow = (*sIterator).boundingRect();
+		cv::calcBackProject(&hsv, 1, &channel, hists[i], bp, ranges);	
+		cv::bitwise_and(bp, masks[i], bp);
+		Rect searchWindow = shapes[i].boundingRect();
 		sanitizeWindow(searchWindow, hsv.cols, hsv.rows);
 		
 		RotatedRect foundObject = cv::CamShift(bp, searchWindow, 
 			cv::TermCriteria(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, 10, 1));
 
-		*sIterator = foundObject;
+		shapes[i] = foundObject;
 	}
 	
 	return shapes.size();
 }
 
 void CamShiftTracker::stopTrackingSingleObject(size_t idx) {
-	assert(shapes.size() == masks.size() && 
-		masks.size() == hists.size() && idx >= 0 && idx < shapes.size());
+	assert(idx >= 0 && idx < objectSlots.size());
 
-	eraseListElement(hists, idx);
-	eraseListElement(masks, idx);
-	eraseListElement(shapes, idx);
-	
-	assert(shapes.size() == masks.size() && masks.size() == hists.size());	
+	objectSlots.erase(idx);
 }
 
 void CamShiftTracker::stopTracking() {
-	hists.clear();
-	shapes.clear();
-	hists.clear();
+	objectSlots.clear();
 	
 	trained = started = false;
 }
@@ -223,8 +222,8 @@ void CamShiftTracker::setVMax(int vMax) {
 */
 void CamShiftTracker::objectShapes(std::vector<const Shape*>& out) const {
 	out.reserve(out.size() + shapes.size());
-	for(std::list<RotatedRect>::const_iterator i = shapes.begin(); i != shapes.end(); i++)
-		out.push_back(static_cast<const Shape*>(&(*i)));
+	for(size_t i = 0; i < shapes.size(); i++)
+		out.push_back(static_cast<const Shape*>(&shapes[i]));
 }
 
 /*! Clips the initial search window to inside the video boundaries.
@@ -4,6 +4,7 @@
 #include <vector>
 #include <cv.h>
 #include "Tracker.h"
+#include "ObjectSlots.h"
 #include "RotatedRect.h"
 
 namespace obt {
@@ -23,6 +24,7 @@ public:
 
 	int start(const TrainingInfo* ti = NULL, int idx = -1);
 	int feed(const cv::Mat& img);
+	int feed(FrameContext& frame);
 
 	int bins() const;
 
@@ -45,9 +47,10 @@ protected:
 	int _vMin; //! Minimum value. See constructor for details. \sa CamShiftTracker()
 	int _vMax; //! Maximum value. See constructor for details. \sa CamShiftTracker()
 		
-	std::list<cv::MatND> hists; //! The hue histogram
-	std::list<RotatedRect> shapes; //! Detected shapes
-	std::list<cv::Mat> masks; //! Masks for histogram calculation.
+	std::vector<cv::MatND> hists; //! The hue histogram
+	std::vector<RotatedRect> shapes; //! Detected shapes
+	std::vector<cv::Mat> masks; //! Masks for histogram calculation.
+	ObjectSlots objectSlots; //! Keeps the per-object vectors in sync
 };
 
 }
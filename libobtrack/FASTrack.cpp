@@ -31,6 +31,15 @@ FASTrack::FASTrack(cv::Ptr<cv::FeatureDetector> featureDetector,
 		extractor(descriptorExtractor),
 		matcher(descriptorMatcher),
 		curDescIndex(0) {
+	objectSlots.attach(masks);
+	objectSlots.attach(prevMaskRects);
+	for(int i = 0; i < 2; i++) {
+		objectSlots.attach(keyPoints[i]);
+		objectSlots.attach(descriptors[i]);
+	}
+	objectSlots.attach(HPrevs);
+	objectSlots.attach(keyPointShapes);
+	objectSlots.attach(latestMatches);
 }
 
 
@@ -55,29 +64,26 @@ int FASTrack::start(const TrainingInfo* ti, int idx) {
 
 	if(defaultMask.rows == 0)
 		defaultMask = cv::Mat::zeros(ti->img.rows, ti->img.cols, CV_8UC1);
-	cv::Mat& mask = updateListElement(masks, idx, defaultMask);
+	if(static_cast<size_t>(idx) == objectSlots.size())
+		objectSlots.add();
 
-	Rect& prevMaskRect = updateListElement(prevMaskRects, idx, Rect(ti->shapes[0]->boundingRect()));
+	cv::Mat& mask = masks[idx] = defaultMask;
+
+	Rect& prevMaskRect = prevMaskRects[idx] = Rect(ti->shapes[0]->boundingRect());
 	cv::rectangle(mask, prevMaskRect, cv::Scalar::all(1));
 	
 	for(int i = 0; i < 2; i++) {
-		updateListElement(keyPoints[i], idx, std::vector<cv::KeyPoint>());
-		updateListElement(descriptors[i], idx, cv::Mat());
+		keyPoints[i][idx].clear();
+		descriptors[i][idx] = cv::Mat();
 	}
 
-	updateListElement(HPrevs, idx, DEFAULT_H);
-
-	detector->detect(ti->img, getListElement(keyPoints[curDescIndex], idx), mask);
-	extractor->compute(ti->img, 
-			getListElement(keyPoints[curDescIndex], idx), 
-			getListElement(descriptors[curDescIndex], idx));
+	HPrevs[idx] = DEFAULT_H;
 
-	if(idx == keyPointShapes.size())
-		keyPointShapes.push_back(prevMaskRect);
-	else
-		updateListElement(keyPointShapes, idx, prevMaskRect);
+	detector->detect(ti->img, keyPoints[curDescIndex][idx], mask);
+	extractor->compute(ti->img, keyPoints[curDescIndex][idx], descriptors[curDescIndex][idx]);
 
-	updateListElement(latestMatches, idx, std::vector<cv::DMatch>());
+	keyPointShapes[idx] = prevMaskRect;
+	latestMatches[idx].clear();
 
 	started = true;
 	return masks.size();
@@ -160,31 +166,16 @@ int FASTrack::feed(const cv::Mat& img) {
 	sanityCheck();
 	
 	curDescIndex = 1 - curDescIndex;
-	keyPointShapes.clear();
-
-	std::list<cv::Mat>::iterator masksIt, HPrevsIt, curDescsIt, prevDescsIt;
-	masksIt = masks.begin();
-	HPrevsIt = HPrevs.begin(); 
-	curDescsIt = descriptors[curDescIndex].begin();
-	prevDescsIt = descriptors[1 - curDescIndex].begin();
-		
-	std::list<std::vector<cv::KeyPoint> >::iterator curKpIt, prevKpIt;
-	curKpIt = keyPoints[curDescIndex].begin();
-	prevKpIt = keyPoints[1 - curDescIndex].begin();
-
-	std::list<Rect>::iterator prevMaskRectsIt = prevMaskRects.begin();
-	std::list<std::vector<cv::DMatch> >::iterator matchesIt = latestMatches.begin(); 
-	for( ; masksIt != masks.end(); 
-			masksIt++, HPrevsIt++, curDescsIt++, prevDescsIt++,
-			curKpIt++, prevKpIt++, prevMaskRectsIt++, matchesIt++) {
-		cv::Mat& mask = *masksIt;
-		cv::Mat& HPrev = *HPrevsIt;
-		cv::Mat& descs = *curDescsIt;
-		cv::Mat& prevDescs = *prevDescsIt;
-		std::vector<cv::KeyPoint>& kps = *curKpIt;
-		std::vector<cv::KeyPoint>& prevKps = *prevKpIt;
-		Rect& prevMaskRect = *prevMaskRectsIt;
-		std::vector<cv::DMatch>& latestMatch = *matchesIt;
+
+	for(size_t obj = 0; obj < objectSlots.size(); obj++) {
+		cv::Mat& mask = masks[obj];
+		cv::Mat& HPrev = HPrevs[obj];
+		cv::Mat& descs = descriptors[curDescIndex][obj];
+		cv::Mat& prevDescs = descriptors[1 - curDescIndex][obj];
+		std::vector<cv::KeyPoint>& kps = keyPoints[curDescIndex][obj];
+		std::vector<cv::KeyPoint>& prevKps = keyPoints[1 - curDescIndex][obj];
+		Rect& prevMaskRect = prevMaskRects[obj];
+		std::vector<cv::DMatch>& latestMatch = latestMatches[obj];
 
 		defaultMask.copyTo(mask);
 		cv::Rect bounding = prevMaskRect = getNewMaskRect(kps, prevMaskRect);
@@ -227,7 +218,7 @@ int FASTrack::feed(const cv::Mat& img) {
 
 		if(!kps.empty()) {
 			if(prevKps.empty()) {
-				keyPointShapes.push_back(getNewMaskRect(kps, prevMaskRect));
+				keyPointShapes[obj] = getNewMaskRect(kps, prevMaskRect);
 				continue;
 			}
 			// Calculate the movement average and standard deviation...
@@ -266,8 +257,8 @@ int FASTrack::feed(const cv::Mat& img) {
 		} // if(!kps.empty())
 
 	
-		keyPointShapes.push_back(getNewMaskRect(kps, prevMaskRect));
-	} // for( ; masksIt != masks.end(); (...)
+		keyPointShapes[obj] = getNewMaskRect(kps, prevMaskRect);
+	} // for(size_t obj = 0; (...)
 
 	return masks.size();
 }
@@ -278,11 +269,8 @@ int FASTrack::feed(const cv::Mat& img) {
 void FASTrack::objectShapes(std::vector<const Shape*>& shapes) const {
 	const int oldSize = shapes.size();
 	shapes.resize(shapes.size() + keyPointShapes.size());
-	std::list<Rect>::const_iterator it;
-	int i;
-	for(i = 0, it = keyPointShapes.begin(); 
-			it != keyPointShapes.end(); i++, it++)
-		shapes[oldSize + i] = &(*it);
+	for(size_t i = 0; i < keyPointShapes.size(); i++)
+		shapes[oldSize + i] = &keyPointShapes[i];
 }
 
 /*! Converts matching indices to xy points
@@ -343,29 +331,13 @@ void FASTrack::stopTrackingSingleObject(size_t idx) {
 		return;
 	}
 
-	eraseListElement(masks, idx);
-	eraseListElement(prevMaskRects, idx);
-	for(int i = 0; i < 2; i++) {
-		eraseListElement(keyPoints[i], idx);
-		eraseListElement(descriptors[i], idx);
-	}	
-	eraseListElement(HPrevs, idx);
-	eraseListElement(keyPointShapes, idx);
-	eraseListElement(latestMatches, idx);
+	objectSlots.erase(idx);
 
 	sanityCheck();
 }
 
 void FASTrack::stopTracking() {
-	masks.clear();
-	prevMaskRects.clear();
-	for(int i = 0; i < 2; i++) {
-		keyPoints[i].clear();
-		descriptors[i].clear();
-	}	
-	HPrevs.clear();
-	keyPointShapes.clear();
-	latestMatches.clear();
+	objectSlots.clear();
 	defaultMask = cv::Mat();
 	started = false;
 
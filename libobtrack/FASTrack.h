@@ -3,6 +3,7 @@
 
 #include <cv.h>
 #include "Tracker.h"
+#include "ObjectSlots.h"
 #include "Rect.h"
 
 class TrainingInfo;
@@ -22,6 +23,7 @@ public:
 
 	virtual int start(const TrainingInfo* ti = NULL, int idx = -1);
 	virtual int feed(const cv::Mat& img);
+	using Tracker::feed;
 
 	virtual void stopTrackingSingleObject(size_t idx);
 	virtual void stopTracking();
@@ -66,20 +68,22 @@ private:
 		better performance, but not by much */
 	float scaleX, scaleY;		
 
-	std::list<cv::Mat> masks; //! Rectangular masks for the object detectors, one per tracked object
-	std::list<Rect> prevMaskRects; //! The previous frame's mask rectangle, for each tracked object
+	std::vector<cv::Mat> masks; //! Rectangular masks for the object detectors, one per tracked object
+	std::vector<Rect> prevMaskRects; //! The previous frame's mask rectangle, for each tracked object
 
-	std::list<std::vector<cv::KeyPoint> > keyPoints[2]; //! Keypoints (current Frame and previous) for each tracked object
-	std::list<cv::Mat> descriptors[2]; //! Descriptors (current Frame and previous) for each tracked object
+	std::vector<std::vector<cv::KeyPoint> > keyPoints[2]; //! Keypoints (current Frame and previous) for each tracked object
+	std::vector<cv::Mat> descriptors[2]; //! Descriptors (current Frame and previous) for each tracked object
 	/*! Holds the current frame's index in the \ref keyPoints and \ref descriptors arrays. The 
 		remaining index will have the previous frame's data.
 	*/
 	int curDescIndex; 
 
-	std::list<cv::Mat> HPrevs; //! Previous frame's Homography matrix.
+	std::vector<cv::Mat> HPrevs; //! Previous frame's Homography matrix.
 
-	std::list<Rect> keyPointShapes; //! Holds detected shapes.
-	std::list<std::vector<cv::DMatch> > latestMatches; //! previous frame's matched keypoints
+	std::vector<Rect> keyPointShapes; //! Holds detected shapes.
+	std::vector<std::vector<cv::DMatch> > latestMatches; //! previous frame's matched keypoints
+
+	ObjectSlots objectSlots; //! Keeps the per-object vectors in sync
 };
 
 }
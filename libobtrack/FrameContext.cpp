@@ -0,0 +1,67 @@
+#include "FrameContext.h"
+#include <cv.h>
+
+namespace obt {
+
+/*! Constructs an empty context. Call setFrame() before requesting any images.
+*/
+FrameContext::FrameContext():
+		_frameNumber(0) {
+}
+
+/*! Constructs a context holding img.
+	\param img A new image, in RGB.
+*/
+FrameContext::FrameContext(const cv::Mat& img):
+		_frameNumber(0) {
+	setFrame(img);
+}
+
+/*! Replaces the held frame, discarding every image derived from the previous one.
+	The discarded images are released, not overwritten, so anyone still
+	holding a reference to them keeps valid data.
+
+	\param img A new image, in RGB.
+*/
+void FrameContext::setFrame(const cv::Mat& img) {
+	this->img = img;
+	_frameNumber++;
+
+	_gray.release();
+	_hsv.release();
+}
+
+/*! Returns the original frame.
+*/
+const cv::Mat& FrameContext::image() const {
+	return img;
+}
+
+/*! Returns a number identifying the current frame. It changes with every call to setFrame().
+*/
+unsigned long FrameContext::frameNumber() const {
+	return _frameNumber;
+}
+
+/*! Returns the frame, converted to gray.
+	If the frame is already single-channel, it is returned as is.
+*/
+const cv::Mat& FrameContext::gray() {
+	if(_gray.empty()) {
+		if(img.channels() == 1)
+			_gray = img;
+		else
+			cv::cvtColor(img, _gray, CV_RGB2GRAY);
+	}
+	return _gray;
+}
+
+/*! Returns the frame, converted to HSV.
+*/
+const cv::Mat& FrameContext::hsv() {
+	if(_hsv.empty())
+		cv::cvtColor(img, _hsv, CV_RGB2HSV);
+	return _hsv;
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef _OBTRACK_FRAME_CONTEXT_H
+#define _OBTRACK_FRAME_CONTEXT_H
+
+#include <cv.h>
+
+namespace obt {
+
+/*! Holds a single frame, along with the preprocessed versions of it that
+	trackers commonly need.
+
+	Every derived image (gray, HSV) is computed lazily, the first time it is
+	requested, and then kept until the next call to \ref setFrame. Handing the
+	same FrameContext to several trackers, or using it for several objects,
+	means each conversion is done at most once per frame. Products in a format
+	of a tracker's own, like the LK pyramids and integral images of
+	TLDTracker, are cached by that tracker.
+
+	The returned images share their data with the context. Since a new buffer
+	is used for every frame, trackers may keep references to them (e.g. as the
+	previous frame) without them being overwritten by the next frame.
+
+	A FrameContext is not thread-safe: request whatever you need before
+	handing it over to multiple threads.
+
+	\sa Tracker::feed
+*/
+class FrameContext {
+public:
+	FrameContext();
+	explicit FrameContext(const cv::Mat& img);
+
+	void setFrame(const cv::Mat& img);
+
+	const cv::Mat& image() const;
+	unsigned long frameNumber() const;
+
+	const cv::Mat& gray();
+	const cv::Mat& hsv();
+
+private:
+	cv::Mat img; //! The original frame. Assumed to be in RGB, like the rest of the library.
+	unsigned long _frameNumber; //! Incremented by every call to setFrame.
+
+	cv::Mat _gray; //! Gray version of img. Empty if not yet calculated.
+	cv::Mat _hsv; //! HSV version of img. Empty if not yet calculated.
+};
+
+}
+
+#endif
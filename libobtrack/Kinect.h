@@ -28,6 +28,7 @@ public:
 	
 	virtual int start(const TrainingInfo* ti = NULL, int idx = -1);	
 	virtual int feed(const cv::Mat& img);
+	using Tracker::feed;
 
 	virtual void objectShapes(std::vector<const Shape*>& shapes) const;
 	virtual void objectShapes2D(std::vector<const Shape*>& shapes, int forImage = 0) const;
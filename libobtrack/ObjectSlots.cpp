@@ -0,0 +1,118 @@
+#include "ObjectSlots.h"
+
+namespace obt {
+
+const size_t ObjectSlots::NO_INDEX;
+
+ObjectSlots::ObjectSlots() {
+}
+
+ObjectSlots::~ObjectSlots() {
+	for(size_t i = 0; i < columns.size(); i++)
+		delete columns[i];
+}
+
+/*! Returns the number of objects.
+*/
+size_t ObjectSlots::size() const {
+	return slots.size();
+}
+
+bool ObjectSlots::empty() const {
+	return slots.empty();
+}
+
+/*! Adds an object at the end, default-constructing its element in every column.
+	\return The new object's index.
+*/
+size_t ObjectSlots::add() {
+	for(size_t i = 0; i < columns.size(); i++)
+		columns[i]->pushBack();
+
+	unsigned int slot = newSlot();
+	slotIndices[slot] = slots.size();
+	slots.push_back(slot);
+
+	return slots.size() - 1;
+}
+
+/*! Removes an object, keeping the remaining ones in order.
+	Objects after idx move one position back, which takes O(n); see swapRemove().
+*/
+void ObjectSlots::erase(size_t idx) {
+	assert(idx < size());
+	for(size_t i = 0; i < columns.size(); i++)
+		columns[i]->erase(idx);
+
+	freeSlot(slots[idx]);
+	slots.erase(slots.begin() + idx);
+	for(size_t i = idx; i < slots.size(); i++)
+		slotIndices[slots[i]] = i;
+}
+
+/*! Removes an object in O(1), by moving the last object into its place.
+	Use this when object order doesn't matter; handles keep track of the moved object.
+*/
+void ObjectSlots::swapRemove(size_t idx) {
+	assert(idx < size());
+	for(size_t i = 0; i < columns.size(); i++)
+		columns[i]->swapRemove(idx);
+
+	freeSlot(slots[idx]);
+	slots[idx] = slots.back();
+	slots.pop_back();
+	if(idx < slots.size())
+		slotIndices[slots[idx]] = idx;
+}
+
+/*! Removes all objects. The columns stay attached.
+*/
+void ObjectSlots::clear() {
+	for(size_t i = 0; i < columns.size(); i++)
+		columns[i]->clear();
+
+	for(size_t i = 0; i < slots.size(); i++)
+		freeSlot(slots[i]);
+	slots.clear();
+}
+
+/*! Returns a handle to the object currently at index idx.
+*/
+ObjectSlots::Handle ObjectSlots::handle(size_t idx) const {
+	assert(idx < size());
+	Handle h;
+	h.slot = slots[idx];
+	h.generation = generations[h.slot];
+	return h;
+}
+
+/*! Returns the current index of the object referred to by h, or NO_INDEX
+	if that object has been removed.
+*/
+size_t ObjectSlots::index(Handle h) const {
+	if(h.slot >= generations.size() || generations[h.slot] != h.generation)
+		return NO_INDEX;
+	return slotIndices[h.slot];
+}
+
+unsigned int ObjectSlots::newSlot() {
+	if(!freeSlots.empty()) {
+		unsigned int slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	slotIndices.push_back(NO_INDEX);
+	generations.push_back(0);
+	return generations.size() - 1;
+}
+
+/*! Invalidates every handle to a slot, and makes it available for reuse.
+*/
+void ObjectSlots::freeSlot(unsigned int slot) {
+	slotIndices[slot] = NO_INDEX;
+	generations[slot]++;
+	freeSlots.push_back(slot);
+}
+
+}
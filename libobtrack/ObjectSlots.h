@@ -0,0 +1,100 @@
+#ifndef _OBTRACK_OBJECT_SLOTS_H
+#define _OBTRACK_OBJECT_SLOTS_H
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+namespace obt {
+
+/*! Per-object state storage for trackers, laid out as a structure of arrays.
+
+	A tracker keeps each kind of per-object state in its own std::vector (a column),
+	and attaches every column to an ObjectSlots instance. From then on, objects are
+	only added or removed through the ObjectSlots, which keeps all columns the same size.
+	Element i of every column belongs to the object at index i, so indexed access is O(1)
+	and each kind of state is stored contiguously.
+
+	Objects can also be referred to by a \ref Handle. Unlike an index, a handle stays
+	valid while its object is tracked, even if removing other objects moves it.
+
+	Columns are referenced, not owned, so ObjectSlots can't be copied.
+*/
+class ObjectSlots {
+public:
+	//! A stable reference to a tracked object. \sa handle(), index()
+	struct Handle {
+		unsigned int slot; //! Slot in the handle table
+		unsigned int generation; //! Incremented each time the slot is reused
+	};
+
+	//! Returned by index() for handles which don't refer to a tracked object anymore.
+	static const size_t NO_INDEX = static_cast<size_t>(-1);
+
+	ObjectSlots();
+	~ObjectSlots();
+
+	template<typename T> void attach(std::vector<T>& column);
+
+	size_t size() const;
+	bool empty() const;
+
+	size_t add();
+	void erase(size_t idx);
+	void swapRemove(size_t idx);
+	void clear();
+
+	Handle handle(size_t idx) const;
+	size_t index(Handle h) const;
+
+private:
+	//! Type-erased access to an attached column.
+	class ColumnBase {
+	public:
+		virtual ~ColumnBase() {}
+		virtual size_t size() const = 0;
+		virtual void pushBack() = 0;
+		virtual void erase(size_t idx) = 0;
+		virtual void swapRemove(size_t idx) = 0;
+		virtual void clear() = 0;
+	};
+
+	template<typename T> class Column : public ColumnBase {
+	public:
+		explicit Column(std::vector<T>& v): v(v) {}
+		size_t size() const { return v.size(); }
+		void pushBack() { v.push_back(T()); }
+		void erase(size_t idx) { v.erase(v.begin() + idx); }
+		void swapRemove(size_t idx) {
+			std::swap(v[idx], v.back());
+			v.pop_back();
+		}
+		void clear() { v.clear(); }
+	private:
+		std::vector<T>& v;
+	};
+
+	ObjectSlots(const ObjectSlots&);
+	ObjectSlots& operator=(const ObjectSlots&);
+
+	unsigned int newSlot();
+	void freeSlot(unsigned int slot);
+
+	std::vector<ColumnBase*> columns; //! The attached columns
+	std::vector<unsigned int> slots; //! The handle slot of each object, by index
+	std::vector<size_t> slotIndices; //! The index of each handle slot's object, or NO_INDEX
+	std::vector<unsigned int> generations; //! The current generation of each handle slot
+	std::vector<unsigned int> freeSlots; //! Handle slots available for reuse
+};
+
+/*! Attaches a column. From now on, its size will be kept equal to the number of objects.
+	\param column The column. It must have exactly size() elements, and must outlive this ObjectSlots.
+*/
+template<typename T> void ObjectSlots::attach(std::vector<T>& column) {
+	assert(column.size() == size());
+	columns.push_back(new Column<T>(column));
+}
+
+}
+
+#endif
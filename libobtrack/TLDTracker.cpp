@@ -1,16 +1,30 @@
 #include "TLDTracker.h"
 #include "TLD.h"
 #include "Rect.h"
+#include "FrameContext.h"
 #include <stdint.h>
 #include <cv.h>
 #include <iostream>
+#include <algorithm>
 
 namespace obt {
 
-/*! Constructs a new TLDTracker.
+/*! Constructs a new TLDTracker. Objects are processed serially until setNumThreads() is called.
 */
 TLDTracker::TLDTracker():
-		Tracker(false, true) {
+		Tracker(false, true),
+		_numThreads(1),
+		_sharedDetection(false) {
+	objectSlots.attach(tlds);
+	objectSlots.attach(objects);
+	objectSlots.attach(latencies);
+	pyramidCache = new tld::PyramidCache();
+	windowGridCache = new tld::WindowGridCache();
+	integralImageCache = new tld::IntegralImageCache();
+}
+
+TLDTracker::~TLDTracker() {
+	stopTracking();
 }
 
 int TLDTracker::start(const TrainingInfo* ti, int idx) {
@@ -26,30 +40,31 @@ int TLDTracker::start(const TrainingInfo* ti, int idx) {
 		idx = -1;
 	}
 
-	int numItemsToAdd;
-	if(idx == -1) {
-		numItemsToAdd = ti->shapes.size();
+	if(idx == -1)
 		idx = tlds.size();
-	}
-	else
-		numItemsToAdd = ti->shapes.size() - (tlds.size() - idx);
 
-	cv::Mat gray;
-	cv::cvtColor(ti->img, gray, CV_RGB2GRAY);
+	FrameContext frame(ti->img);
+	const cv::Mat& gray = frame.gray();
+	const unsigned long frameId = tld::tldNewFrameId();
 
-	tlds.reserve(tlds.size() + numItemsToAdd);
-	objects.reserve(tlds.size() + numItemsToAdd);
 	for(size_t i = 0; i < ti->shapes.size(); i++) {
 		cv::Rect curRect = ti->shapes[i]->boundingRect();
 		if(idx + i < tlds.size()) {
 			tlds[idx + i]->release();
 		}
-		else
-			tlds.push_back(new tld::TLD());
+		else {
+			objectSlots.add();
+			tlds[idx + i] = new tld::TLD();
+			tlds[idx + i]->medianFlowTracker->pyramidCache = pyramidCache;
+			tlds[idx + i]->detectorCascade->windowGridCache = windowGridCache;
+			tlds[idx + i]->detectorCascade->varianceFilter->integralImageCache = integralImageCache;
+		}
+		objects[idx + i] = curRect;
+		latencies[idx + i] = 0;
 		tlds[idx + i]->detectorCascade->imgWidth = gray.cols;
 		tlds[idx + i]->detectorCascade->imgHeight = gray.rows;
 		tlds[idx + i]->detectorCascade->imgWidthStep = gray.step;
-		tlds[idx + i]->selectObject(gray, &curRect);
+		tlds[idx + i]->selectObject(gray, &curRect, frameId);
 	}
 
 	started = true;
@@ -58,38 +73,192 @@ int TLDTracker::start(const TrainingInfo* ti, int idx) {
 }
 
 int TLDTracker::feed(const cv::Mat& img) {
+	FrameContext frame(img);
+	return feed(frame);
+}
+
+/*! Uses the frame's gray image.
+
+	Every object has its own TLD instance, which only reads the shared gray image,
+	so if more than one thread has been requested (see setNumThreads()), objects
+	are processed concurrently. Each result is written to its object's slot,
+	so the output doesn't depend on the order in which the threads finish.
+
+	\sa Tracker::feed
+*/
+int TLDTracker::feed(FrameContext& frame) {
 	if(!started)
 		return NO_HINT;
 
-	cv::Mat gray;
-	cv::cvtColor(img, gray, CV_RGB2GRAY);
-	for(size_t i = 0; i < tlds.size(); i++) {
-		tlds[i]->processImage(gray, true);
-		const Rect& curRect = (tlds[i]->currBB == NULL ? INVALID_RECT : *(tlds[i]->currBB));
-		if(i < objects.size())
-			objects[i] = curRect;
-		else
-			objects.push_back(curRect);		
+	const cv::Mat& gray = frame.gray();
+	const int numObjects = static_cast<int>(tlds.size());
+	const int numThreads = std::max(1, std::min(_numThreads, numObjects));
+	const unsigned long frameId = tld::tldNewFrameId(); //The objects share their caches, so they must agree on it
+
+	if(_sharedDetection) {
+		feedShared(gray, frameId, numThreads);
+		return tlds.size();
+	}
+
+	#pragma omp parallel for num_threads(numThreads) schedule(dynamic) if(numThreads > 1)
+	for(int i = 0; i < numObjects; i++) {
+		int64 start = cv::getTickCount();
+		tlds[i]->processImage(gray, true, frameId);
+		objects[i] = (tlds[i]->currBB == NULL ? INVALID_RECT : *(tlds[i]->currBB));
+		latencies[i] = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
 	}
 	return tlds.size();
 }
 
+/*! feed() with shared detection: all objects are tracked, then their detectors run together
+	in one pass over the frame, then each object fuses and learns.
+	\param gray The frame.
+	\param frameId Identifies the frame, see tld::tldNewFrameId().
+	\param numThreads The number of threads for tracking and learning.
+*/
+void TLDTracker::feedShared(const cv::Mat& gray, unsigned long frameId, int numThreads) {
+	const int numObjects = static_cast<int>(tlds.size());
+
+	#pragma omp parallel for num_threads(numThreads) schedule(dynamic) if(numThreads > 1)
+	for(int i = 0; i < numObjects; i++) {
+		int64 start = cv::getTickCount();
+		tlds[i]->finishLearning(); //Left over from feed() without shared detection
+		tlds[i]->trackFrame(gray, frameId);
+		latencies[i] = (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency();
+	}
+
+	std::vector<tld::DetectorCascade*>& cascades = sharedCascades;
+	cascades.clear();
+	for(int i = 0; i < numObjects; i++) {
+		if(tlds[i]->wantsDetection())
+			cascades.push_back(tlds[i]->detectorCascade);
+	}
+
+	int64 detectionStart = cv::getTickCount();
+	if(!cascades.empty())
+		tld::DetectorCascade::detectTogether(gray, frameId, &cascades[0], cascades.size());
+	double detectionLatency = (cv::getTickCount() - detectionStart) * 1000.0 / cv::getTickFrequency();
+
+	#pragma omp parallel for num_threads(numThreads) schedule(dynamic) if(numThreads > 1)
+	for(int i = 0; i < numObjects; i++) {
+		int64 start = cv::getTickCount();
+		tlds[i]->fuseAndLearn();
+		objects[i] = (tlds[i]->currBB == NULL ? INVALID_RECT : *(tlds[i]->currBB));
+		latencies[i] += (cv::getTickCount() - start) * 1000.0 / cv::getTickFrequency() + detectionLatency;
+	}
+}
+
 void TLDTracker::stopTrackingSingleObject(size_t idx) {
 	assert(idx >= 0 && idx < tlds.size());
 	if(tlds.size() == 1) {
 		stopTracking();
 		return;
 	}
-	tlds.erase(tlds.begin() + idx);
-	objects.erase(objects.begin() + idx);
+	delete tlds[idx];
+	objectSlots.erase(idx);
 }
 
 void TLDTracker::stopTracking() {
-	tlds.clear();
-	objects.clear();
+	for(size_t i = 0; i < tlds.size(); i++)
+		delete tlds[i];
+	objectSlots.clear();
 	started = false;
 }
 
+/*! Sets the number of threads feed() uses to process objects concurrently.
+	At most one thread per object is used.
+	\param numThreads The number of threads. 1 or less means objects are processed serially.
+*/
+void TLDTracker::setNumThreads(int numThreads) {
+	_numThreads = numThreads;
+}
+
+int TLDTracker::numThreads() const {
+	return _numThreads;
+}
+
+/*! Lets feed() run the detectors of all objects together instead of one after the other.
+
+	Each frame's integral images are always built once for all objects. With shared detection,
+	objects with the same detector windows, which objects of the same size have, are also scanned
+	in a single pass: the variance of each window is calculated once, and every object's ferns
+	evaluate it in turn. Only the NN classifier stays per object.
+	Objects of different sizes are scanned in separate passes, each calculating the variances of
+	its own windows. Their scales rarely match: in a 320x240 frame, a 50x50 object has 31053
+	windows in 12 scales and a 55x55 object 37153 windows in 13 scales, none of the same size,
+	so the two passes calculate 68206 variances. Objects whose sizes differ by a power of 1.2
+	mostly share scales, but still get separate passes.
+	The detectors then always scan the whole frame, and each object learns from a frame before
+	the next one is fed: the TLD modes restrictSearch, pipelined and asyncLearning, and the
+	sliced scans of DetectorCascade::numScanSlices and scanTimeBudget, only take effect without
+	shared detection. The latency of an object includes the time of the shared pass.
+	\param shared true to share the pass over the frame.
+*/
+void TLDTracker::setSharedDetection(bool shared) {
+	_sharedDetection = shared;
+}
+
+bool TLDTracker::sharedDetection() const {
+	return _sharedDetection;
+}
+
+/*! Returns the time spent processing an object during the latest call to feed(), in milliseconds.
+	When objects are processed concurrently, latencies overlap, so they don't add up to the frame time.
+*/
+double TLDTracker::objectLatency(size_t idx) const {
+	assert(idx < latencies.size());
+	return latencies[idx];
+}
+
+/*! Saves the state of an object's tracker to a file, from which startFromCheckpoint() resumes it.
+
+	The first checkpoint of an object to a path holds its whole model. Further checkpoints to the
+	same path only append what the tracker has learned since the previous one, so they are cheap
+	enough to be written every few seconds between calls to feed().
+	\param idx The object.
+	\param path The checkpoint file.
+	\return false if the file could not be written. The next checkpoint will then hold the whole model again.
+*/
+bool TLDTracker::writeCheckpoint(size_t idx, const char* path) {
+	assert(idx < tlds.size());
+	return tlds[idx]->writeCheckpoint(path);
+}
+
+/*! Resumes tracking an object from a file written by writeCheckpoint().
+
+	The object is found again by the detector in the next frame passed to feed().
+	Further checkpoints of the object to path are appended to it.
+	\param path The checkpoint file.
+	\param idx The object to replace, or -1 to add a new one.
+	\return The number of tracked objects, or NO_HINT if the checkpoint could not be read, in which case nothing changes.
+*/
+int TLDTracker::startFromCheckpoint(const char* path, int idx) {
+	tld::TLD* tld = new tld::TLD();
+	tld->medianFlowTracker->pyramidCache = pyramidCache;
+	tld->detectorCascade->windowGridCache = windowGridCache;
+	tld->detectorCascade->varianceFilter->integralImageCache = integralImageCache;
+	if(!tld->readCheckpoint(path)) {
+		std::cerr << "ERROR: TLDTracker::startFromCheckpoint: cannot read " << path << std::endl;
+		delete tld;
+		return NO_HINT;
+	}
+
+	if(idx < 0 || idx >= static_cast<int>(tlds.size())) {
+		idx = tlds.size();
+		objectSlots.add();
+	}
+	else {
+		delete tlds[idx];
+	}
+	tlds[idx] = tld;
+
+	objects[idx] = (tlds[idx]->currBB == NULL ? INVALID_RECT : *(tlds[idx]->currBB));
+	latencies[idx] = 0;
+	started = true;
+
+	return tlds.size();
+}
+
 void TLDTracker::objectShapes(std::vector<const Shape*>& shapes) const {
 	shapes.reserve(shapes.size() + objects.size());
 	for(size_t i = 0; i < objects.size(); i++)
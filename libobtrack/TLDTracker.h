@@ -2,11 +2,15 @@
 #define _OBTRACK_TLD_TRACKER_H
 
 #include "Tracker.h"
+#include "ObjectSlots.h"
 #include "Rect.h"
 #include <cv.h>
 
 namespace tld {
 class TLD;
+class PyramidCache;
+class WindowGridCache;
+class IntegralImageCache;
 }
 
 namespace obt {
@@ -25,15 +29,37 @@ class TrainingInfo;
 class TLDTracker : public Tracker {
 public:
 	TLDTracker();
+	~TLDTracker();
 	int start(const TrainingInfo* ti = NULL, int idx = -1);
 	int feed(const cv::Mat& img);
+	int feed(FrameContext& frame);
 	void stopTrackingSingleObject(size_t idx);
 	void stopTracking();
 	void objectShapes(std::vector<const Shape*>& shapes) const;
 
+	void setNumThreads(int numThreads);
+	int numThreads() const;
+	void setSharedDetection(bool shared);
+	bool sharedDetection() const;
+	double objectLatency(size_t idx) const;
+
+	bool writeCheckpoint(size_t idx, const char* path);
+	int startFromCheckpoint(const char* path, int idx = -1);
+
 private:
-	std::vector<tld::TLD*> tlds;
-	std::vector<Rect> objects;
+	int _numThreads; //! Number of threads used by feed(). 1 or less means objects are processed serially.
+	bool _sharedDetection; //! Whether feed() runs the detectors of all objects together
+
+	std::vector<tld::TLD*> tlds; //! One TLD instance per tracked object
+	std::vector<Rect> objects; //! Latest bounding box of each object
+	std::vector<double> latencies; //! Time spent on each object by the latest feed(), in milliseconds
+	cv::Ptr<tld::PyramidCache> pyramidCache; //! Shared by all objects, so each frame's pyramid is built once
+	cv::Ptr<tld::WindowGridCache> windowGridCache; //! Shared by all objects, so objects of the same size share their detector windows
+	cv::Ptr<tld::IntegralImageCache> integralImageCache; //! Shared by all objects, so each frame's integral images are built once
+	ObjectSlots objectSlots; //! Keeps the per-object vectors in sync
+	std::vector<tld::DetectorCascade*> sharedCascades; //! Detectors feedShared() runs together, kept to reuse the memory
+
+	void feedShared(const cv::Mat& gray, unsigned long frameId, int numThreads);
 };
 
 }
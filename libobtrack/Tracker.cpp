@@ -1,4 +1,5 @@
 #include "Tracker.h"
+#include "FrameContext.h"
 #include <iostream>
 
 namespace obt {
@@ -48,6 +49,21 @@ bool Tracker::train(const TrainingInfo& ti) {
 	return defaultTrainImpl();
 }
 
+/*! Feeds a new frame to the object tracker, sharing its preprocessed images
+	(gray, HSV...) with any other tracker fed the same FrameContext.
+	Trackers which need such images should override this, and have
+	feed(const cv::Mat&) forward to it.
+	By default, calls feed(frame.image()).
+
+	\param frame A new frame.
+	\return The number of detected objects in the image.
+
+	\sa FrameContext
+*/
+int Tracker::feed(FrameContext& frame) {
+	return feed(frame.image());
+}
+
 bool Tracker::defaultTrainImpl() {
 	if(_needsTraining)  {
 		std::cerr << "Tracker::train: This tracker needs training."
@@ -3,12 +3,13 @@
 
 #include "TrainingInfo.h"
 #include "Skeleton.h"
-#include <list>
 #include <vector>
 #include <limits>
 
 namespace obt {
 
+class FrameContext;
+
 /*! The base class for all object trackers.
 	Can handle both single-object and multi-object trackers.
 	To keep the interface consistent, single-object trackers will
@@ -57,6 +58,7 @@ public:
 		\sa start
 	 */
 	virtual int feed(const cv::Mat& img) = 0;
+	virtual int feed(FrameContext& frame);
 
 	bool needsTraining() const;
 	bool needsHint() const;
@@ -70,19 +72,14 @@ public:
 	virtual void stopTracking();
 
 	/*! Appends the shapes found to a vector.
-		The contents are only guaranteed to be valid pointers until the next call to feed().
+		The contents are only guaranteed to be valid pointers until the next call to feed(),
+		start(), stopTrackingSingleObject() or stopTracking().
 		\param shapes Output. The found shapes will be appended to this vector.
 	*/
 	virtual void objectShapes(std::vector<const Shape*>& shapes) const = 0;
 	virtual void objectShapes2D(std::vector<const Shape*>& shapes, int forImage = 0) const;
 
 protected:
-	template<typename T> static T& updateListElement(
-		std::list<T>& list, size_t i, const T& newValue);
-	template<typename T> static T& getListElement(std::list<T>& list, size_t i);
-	template<typename T> static void eraseListElement(std::list<T>& list, size_t i);
-
-
 	bool trained; //! If true, this tracker has already been trained and it is ready to start tracking objects
 	bool started; //! If true, initial object detection has been done
 
@@ -95,41 +92,6 @@ private:
 	bool defaultTrainImpl();
 };
 
-/*! Updates a list element. If idx == l.size(), adds a value to the end of the list,
-*/
-template<typename T> T& Tracker::updateListElement(
-				std::list<T>& l, size_t idx, const T& newValue) {
-	assert(idx >= 0 && idx <= l.size());
-	if(idx == l.size()) {
-		l.push_back(newValue);
-		return l.back();
-	}
-	else {
-		std::list<T>::iterator it = l.begin();
-		std::advance(it, idx);
-		*it = newValue;
-		return *it;
-	}
-}
-
-/*! Gets a list's element by index.
-*/
-template<typename T> T& Tracker::getListElement(std::list<T>& list, size_t idx) {
-	assert(idx >= 0 && idx < list.size());
-	std::list<T>::iterator it = list.begin();
-	std::advance(it, idx);
-	return *it;
-}
-
-/*! Erases a list's element by index.
-*/
-template<typename T> void Tracker::eraseListElement(std::list<T>& list, size_t idx) {
-	assert(idx >= 0 && idx < list.size());
-	std::list<T>::iterator it = list.begin();
-	std::advance(it, idx);
-	list.erase(it);
-}
-
 }
 
 
@@ -3,6 +3,7 @@
 
 #include "CamShiftTracker.h"
 #include "FASTrack.h"
+#include "FrameContext.h"
 #include "TLDTracker.h"
 #include "TrainingInfo.h"
 #include "RotatedRect.h"
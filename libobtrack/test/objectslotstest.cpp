@@ -0,0 +1,62 @@
+/*	Checks ObjectSlots: columns stay in sync, swapRemove() moves the last object,
+	and handles follow their object until it is removed.
+
+	Build: g++ -I.. objectslotstest.cpp ../ObjectSlots.cpp -o objectslotstest
+*/
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include <string>
+#include "ObjectSlots.h"
+
+using obt::ObjectSlots;
+
+int main() {
+	std::vector<int> ids;
+	std::vector<std::string> names;
+	ObjectSlots slots;
+	slots.attach(ids);
+	slots.attach(names);
+
+	const char* labels[] = {"a", "b", "c", "d"};
+	ObjectSlots::Handle handles[4];
+	for(int i = 0; i < 4; i++) {
+		size_t idx = slots.add();
+		ids[idx] = i;
+		names[idx] = labels[i];
+		handles[i] = slots.handle(idx);
+	}
+	assert(slots.size() == 4 && ids.size() == 4 && names.size() == 4);
+
+	//"d" takes the place of "b"
+	slots.swapRemove(1);
+	assert(slots.size() == 3 && ids.size() == 3 && names.size() == 3);
+	assert(ids[1] == 3 && names[1] == "d");
+	assert(slots.index(handles[1]) == ObjectSlots::NO_INDEX);
+	assert(slots.index(handles[3]) == 1);
+	assert(slots.index(handles[0]) == 0 && slots.index(handles[2]) == 2);
+
+	//"c" moves back behind "d"
+	slots.erase(0);
+	assert(ids[0] == 3 && ids[1] == 2 && names[1] == "c");
+	assert(slots.index(handles[0]) == ObjectSlots::NO_INDEX);
+	assert(slots.index(handles[3]) == 0 && slots.index(handles[2]) == 1);
+
+	//A reused slot doesn't revive old handles
+	size_t idx = slots.add();
+	ObjectSlots::Handle fresh = slots.handle(idx);
+	assert(slots.index(fresh) == idx);
+	assert(slots.index(handles[0]) == ObjectSlots::NO_INDEX);
+	assert(slots.index(handles[1]) == ObjectSlots::NO_INDEX);
+
+	slots.swapRemove(slots.size() - 1);
+	assert(slots.index(fresh) == ObjectSlots::NO_INDEX);
+
+	slots.clear();
+	assert(slots.empty() && ids.empty() && names.empty());
+	assert(slots.index(handles[2]) == ObjectSlots::NO_INDEX);
+
+	printf("ObjectSlots OK\n");
+	return 0;
+}